@@ -3,17 +3,325 @@
 #include "abieos.h"
 #include "abieos.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
 
 using namespace abieos;
 
-struct abieos_context_s {
+// A read-only mapping of a file, or of a POSIX shared memory object. Abis loaded from a registry file reference its
+// bytes, and keep it mapped.
+struct mapped_file {
+    const char* data = nullptr;
+    size_t size = 0;
+
+    explicit mapped_file(const char* path, bool shared_memory = false) {
+        int fd = shared_memory ? shm_open(path, O_RDONLY, 0) : open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw std::runtime_error("can't open " + std::string{path} + ": " + strerror(errno));
+        struct stat st;
+        void* p = nullptr;
+        if (fstat(fd, &st) == 0) {
+            size = st.st_size;
+            p = size ? mmap(nullptr, size, PROT_READ, shared_memory ? MAP_SHARED : MAP_PRIVATE, fd, 0) : nullptr;
+        }
+        auto error = errno;
+        close(fd);
+        if (p == MAP_FAILED || (size && !p))
+            throw std::runtime_error("can't map " + std::string{path} + ": " + strerror(error));
+        data = static_cast<const char*>(p);
+    }
+
+    mapped_file(const mapped_file&) = delete;
+
+    ~mapped_file() {
+        if (data)
+            munmap(const_cast<char*>(data), size);
+    }
+};
+
+// The fixed-size shared memory object a shared registry is named by. Each publication is a registry file in a separate
+// object, named after this one and its generation. A publisher reserves a generation, so that concurrent publishers
+// never write the same object, and writes it in full before it advances generation.
+struct shared_registry_control {
+    char magic[8];
+    std::atomic<uint64_t> generation; // 0 until the first publication
+    std::atomic<uint64_t> reserved;   // the last generation a publisher reserved
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared registries need lock-free atomics");
+
+constexpr char shared_registry_magic[8] = {'a', 'b', 'i', 'e', 'o', 's', 'S', 'R'};
+
+// Identifies abis by content. Registry files store it, so it must not vary between processes.
+uint64_t abi_hash(std::string_view bytes) {
+    uint64_t hash = 0xcbf2'9ce4'8422'2325; // FNV-1a
+    for (auto c : bytes) {
+        hash ^= uint8_t(c);
+        hash *= 0x100'0000'01b3;
+    }
+    return hash;
+}
+
+// An abi as it was set. It's compiled the first time a conversion needs it. The contract doesn't change after that, but
+// the registry may evict it to stay within its compiled limit; it's compiled again if it's needed again. An abi loaded
+// from a registry file which holds its contract's image uses that instead, where it's mapped, and is never compiled.
+struct registered_abi {
+    abieos_registry* registry;
+    bool binary = false;
+    uint64_t hash = 0; // abi_hash(bytes)
+    hooked_string owned_bytes{};
+    std::shared_ptr<const mapped_file> file{}; // if bytes are part of a mapped registry file
+    std::string_view bytes{};
+    std::optional<::abieos::contract> mapped{}; // refers to an image in file
+
+    // A conversion pins the abi while it uses the contract; eviction skips pinned abis. See get_contract.
+    mutable std::atomic<uint32_t> pins{};
+    mutable std::atomic<const ::abieos::contract*> ready{}; // points to mapped, or to compiled while it's available
+    mutable std::atomic<uint64_t> last_used{};             // registry->clock when a conversion last used the contract
+
+    // Guarded by compile_mutex. serial is also readable while the abi is pinned and ready is set.
+    mutable std::mutex compile_mutex{};
+    mutable allocator_hooks compiled_hooks{}; // forwards to the registry's hooks; counts what compiled uses
+    mutable std::optional<::abieos::contract> compiled{};
+    mutable size_t compiled_size = 0;
+    mutable uint64_t serial = 0; // identifies the compilation; type pointers from an earlier one are dangling
+    mutable bool evicted = false;
+
+    // Copies bytes unless they're part of file. image, if not null, is part of file too.
+    registered_abi(abieos_registry* registry, bool binary, uint64_t hash, std::string_view bytes,
+                   std::shared_ptr<const mapped_file> file = {}, const contract_image* image = nullptr);
+    ~registered_abi();
+};
+
+using abi_ptr = std::shared_ptr<const registered_abi>;
+
+struct abieos_type_handle_s {
+    name contract{};
+    std::string_view type_name{}; // the handle's key in type_handles
+    abi_ptr abi{};                // the handle is stale once the registry holds a different abi
+    mutable const abi_type* type = nullptr;
+    mutable uint64_t serial = 0; // abi's compilation which type points into
+};
+
+struct result_slab;
+
+struct abieos_result_s {
+    std::atomic<uint32_t> refs{0};
+    result_slab* slab = nullptr;
+    abieos_result* next_free = nullptr;
+    hooked_string data{};
+};
+
+// Results are carved out of fixed-size blocks and recycled through a free list; recycled results keep their data
+// capacity. The slab lives until its context and every result it handed out are gone. Results may be released from
+// any thread.
+struct result_slab {
+    static constexpr size_t block_size = 64;
+
+    allocator_hooks hooks{}; // outlives everything below
+    std::mutex mutex{};
+    std::vector<std::unique_ptr<abieos_result[]>> blocks{};
+    abieos_result* free_list = nullptr;
+    size_t owners = 1; // the context, plus one per live result
+
+    abieos_result* alloc() {
+        std::lock_guard lock{mutex};
+        if (!free_list) {
+            auto& block = blocks.emplace_back(std::make_unique<abieos_result[]>(block_size));
+            for (size_t i = 0; i < block_size; ++i) {
+                block[i].slab = this;
+                block[i].next_free = free_list;
+                free_list = &block[i];
+            }
+        }
+        auto* result = free_list;
+        free_list = result->next_free;
+        result->refs.store(1, std::memory_order_relaxed);
+        ++owners;
+        return result;
+    }
+
+    // Returns result (if any) to the free list and drops one owner. Destroys the slab when no owners remain.
+    static void release(result_slab* slab, abieos_result* result) noexcept {
+        bool last;
+        {
+            std::lock_guard lock{slab->mutex};
+            if (result) {
+                result->data.clear();
+                result->next_free = slab->free_list;
+                slab->free_list = result;
+            }
+            last = !--slab->owners;
+        }
+        if (last)
+            delete slab;
+    }
+};
+
+struct result_slab_owner {
+    result_slab* slab = nullptr;
+
+    explicit result_slab_owner(result_slab* slab) : slab{slab} {}
+    result_slab_owner(const result_slab_owner&) = delete;
+    ~result_slab_owner() { result_slab::release(slab, nullptr); }
+};
+
+// Conversions without a block height use the contract's latest abi
+constexpr uint32_t latest_block = 0xffff'ffff;
+
+struct abi_version {
+    uint32_t height = 0; // the abi is in force from this block until the next version's
+    abi_ptr abi{};
+};
+
+// A contract's abis, ordered by height. Versions set from identical bytes share one abi.
+using abi_history = hooked_vector<abi_version>;
+
+// An immutable set of abis. Replacing an abi publishes a new snapshot; the old one, and any abi only it references, is
+// freed once the last conversion using it lets go.
+struct registry_snapshot {
+    hooked_map<name, abi_history> contracts{};
+};
+
+using snapshot_ptr = std::shared_ptr<const registry_snapshot>;
+
+// Readers never lock: they check generation and, only if it moved, atomically load current. Writers serialize on
+// writer_mutex, copy the snapshot (abis themselves are shared, not copied), and publish the copy.
+struct abieos_registry_s {
+    std::atomic<uint32_t> refs{1};
+    allocator_hooks hooks{}; // a context's private registry allocates through the context's functions, but counts apart
+
+    // Compiled contracts. Guarded by lru_mutex, which is never held while waiting for an abi's compile_mutex.
+    std::mutex lru_mutex{};
+    std::set<const registered_abi*, std::less<>, context_allocator<const registered_abi*>> compiled_abis{};
+    size_t compiled_limit = 0; // 0 means no limit
+    uint64_t compiled_bytes = 0;
+    uint64_t compiles = 0;
+    uint64_t recompiles = 0;
+    uint64_t evictions = 0;
+    std::atomic<uint64_t> clock{}; // advanced by each compile; eviction order is by the last clock an abi was used at
+
+    std::mutex writer_mutex{};
+    snapshot_ptr current{};             // only accessed through std::atomic_load and std::atomic_store
+    std::atomic<uint64_t> generation{}; // incremented after each publication
+
+    // Abis by hash of their bytes, so that contracts set from identical bytes share one abi. An entry is dropped once
+    // no snapshot uses its abi. Guarded by writer_mutex.
+    hooked_map<uint64_t, hooked_vector<std::weak_ptr<const registered_abi>>> abi_cache{};
+    size_t abi_cache_sweep = 64; // drop expired entries once abi_cache has this many hashes
+
+    // Set once the registry is attached to a shared registry; see sync_shared
+    std::atomic<const shared_registry_control*> shared_control{};
+    std::atomic<uint64_t> shared_generation{};                // the publication the registry holds
+    std::shared_ptr<const mapped_file> shared_control_file{}; // guarded by writer_mutex
+    hooked_string shared_name{};                              // guarded by writer_mutex
+
+    // Copies allocator's functions rather than referring to it, since a private registry may outlive its context
+    explicit abieos_registry_s(const allocator_hooks* allocator) {
+        if (allocator) {
+            hooks.alloc_fn = allocator->alloc_fn;
+            hooks.free_fn = allocator->free_fn;
+            hooks.user = allocator->user;
+        }
+        allocator_scope scope{&hooks};
+        current = std::allocate_shared<registry_snapshot>(context_allocator<registry_snapshot>{});
+        abi_cache = decltype(abi_cache){};
+        compiled_abis = decltype(compiled_abis){};
+        shared_name = hooked_string{};
+    }
+
+    static void release(abieos_registry* registry) noexcept {
+        if (registry && registry->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete registry;
+    }
+};
+
+registered_abi::registered_abi(abieos_registry* registry, bool binary, uint64_t hash, std::string_view bytes,
+                               std::shared_ptr<const mapped_file> file, const contract_image* image)
+    : registry{registry}, binary{binary}, hash{hash}, file{std::move(file)}, bytes{bytes} {
+    if (!this->file) {
+        owned_bytes.assign(bytes.begin(), bytes.end());
+        this->bytes = owned_bytes;
+    }
+    if (image) {
+        mapped.emplace(image);
+        ready.store(&*mapped, std::memory_order_relaxed);
+    }
+    compiled_hooks.alloc_fn = [](void* user, size_t size) {
+        return static_cast<allocator_hooks*>(user)->allocate(size);
+    };
+    compiled_hooks.free_fn = [](void* user, void* p, size_t size) {
+        static_cast<allocator_hooks*>(user)->deallocate(p, size);
+    };
+    compiled_hooks.user = &registry->hooks;
+}
+
+registered_abi::~registered_abi() {
+    std::lock_guard lock{registry->lru_mutex};
+    if (registry->compiled_abis.erase(this))
+        registry->compiled_bytes -= compiled_size;
+}
+
+struct registry_owner {
+    abieos_registry* registry = nullptr;
+
+    explicit registry_owner(abieos_registry* registry) : registry{registry} {}
+    registry_owner(const registry_owner&) = delete;
+    ~registry_owner() { abieos_registry_s::release(registry); }
+};
+
+// Buffers a conversion works in. Each keeps its capacity between calls unless it grows past the context's scratch
+// limit. Also holds the error from the last call which used it, and the registry snapshot the call runs against.
+struct conversion_scratch {
+    abieos_context* context;
     const char* last_error = "";
     std::string last_error_buffer{};
-    std::string result_str{};
-    std::vector<char> result_bin{};
+    snapshot_ptr snapshot{};
+    uint64_t snapshot_generation = 0;
+    const registered_abi* pinned = nullptr; // until the end of the call
+    json_to_bin_state json_to_bin{};
+    hooked_string mutable_json{};
+    bin_to_json_state bin_to_json{};
+    scratch_arena arena{}; // reset at the end of every call
+
+    explicit conversion_scratch(abieos_context* context) : context{context} {}
+};
+
+// Members other than results bind to results.slab->hooks when constructed; see abieos_create_with_allocator.
+struct abieos_context_s {
+    result_slab_owner results; // destroyed last; owns the allocator hooks
+    registry_owner registry;   // destroyed after everything which may reference its snapshots
+    bool private_registry;     // created with the context; its allocations count as the context's
+    std::atomic<size_t> scratch_limit = 256 * 1024;
+    conversion_scratch scratch{this}; // used by every function except the concurrent ones
+    hooked_string result_str{};
+    hooked_vector<hooked_string> bulk_errors{}; // from abieos_set_abis_bin
+    hooked_vector<char> result_bin{};
+    hooked_map<std::pair<name, hooked_string>, abieos_type_handle> type_handles{};
 
-    std::map<name, contract> contracts{};
+    // Scratches lent to concurrent conversions
+    std::mutex pool_mutex{};
+    std::list<conversion_scratch, context_allocator<conversion_scratch>> scratch_pool{};
+    hooked_vector<conversion_scratch*> free_scratch{};
+
+    abieos_context_s(result_slab* slab, abieos_registry* registry, bool private_registry)
+        : results{slab}, registry{registry}, private_registry{private_registry} {}
+
+    allocator_hooks& hooks() { return results.slab->hooks; }
 };
 
 void fix_null_str(const char*& s) {
@@ -21,44 +329,1075 @@ void fix_null_str(const char*& s) {
         s = "";
 }
 
-void set_error(abieos_context* context, const char* error) noexcept {
+void set_error(conversion_scratch& scratch, const char* error) noexcept {
     try {
-        context->last_error_buffer = error;
-        context->last_error = context->last_error_buffer.c_str();
+        scratch.last_error_buffer = error;
+        scratch.last_error = scratch.last_error_buffer.c_str();
     } catch (...) {
-        context->last_error = "exception while recording error";
+        scratch.last_error = "exception while recording error";
     }
 }
 
+// Empties a buffer, releasing its memory if it grew past the context's scratch limit
+template <typename T>
+void reset_buffer(conversion_scratch& scratch, T& buffer) noexcept {
+    buffer.clear();
+    if (buffer.capacity() * sizeof(buffer[0]) > scratch.context->scratch_limit.load(std::memory_order_relaxed))
+        buffer.shrink_to_fit();
+}
+
+struct scratch_trimmer {
+    conversion_scratch& scratch;
+
+    ~scratch_trimmer() {
+        auto limit = scratch.context->scratch_limit.load(std::memory_order_relaxed);
+        auto& j2b = scratch.json_to_bin;
+        if (j2b.bin.capacity() > limit)
+            reset_buffer(scratch, j2b.bin);
+        if (j2b.size_insertions.capacity() * sizeof(size_insertion) > limit)
+            reset_buffer(scratch, j2b.size_insertions);
+        if (j2b.received_data.value_string.capacity() > limit)
+            reset_buffer(scratch, j2b.received_data.value_string);
+        if (scratch.mutable_json.capacity() > limit)
+            reset_buffer(scratch, scratch.mutable_json);
+        if (scratch.arena.capacity() > limit)
+            scratch.arena.blocks.clear();
+    }
+};
+
+void sync_shared(abieos_registry* registry);
+
+// Picks up the registry's latest snapshot. Costs one atomic load unless an abi was replaced since the last call, or the
+// registry is attached to a shared registry.
+void refresh_snapshot(conversion_scratch& scratch) {
+    auto* registry = scratch.context->registry.registry;
+    sync_shared(registry);
+    auto generation = registry->generation.load(std::memory_order_acquire);
+    if (scratch.snapshot && generation == scratch.snapshot_generation)
+        return;
+    scratch.snapshot = std::atomic_load(&registry->current);
+    scratch.snapshot_generation = generation;
+}
+
+void unpin(conversion_scratch& scratch) noexcept {
+    if (scratch.pinned)
+        scratch.pinned->pins.fetch_sub(1, std::memory_order_release);
+    scratch.pinned = nullptr;
+}
+
+struct abi_unpinner {
+    conversion_scratch& scratch;
+
+    ~abi_unpinner() { unpin(scratch); }
+};
+
 template <typename T, typename F>
-auto handle_exceptions(abieos_context* context, T errval, F f) noexcept -> decltype(f()) {
-    if (!context)
-        return errval;
+auto handle_exceptions(abieos_context* context, conversion_scratch& scratch, T errval, F f) noexcept -> decltype(f()) {
+    allocator_scope scope{&context->hooks()};
+    scratch_trimmer trimmer{scratch};
+    abi_unpinner unpinner{scratch};
+    scratch_arena_scope arena_scope{&scratch.arena};
     try {
+        refresh_snapshot(scratch);
         return f();
     } catch (std::exception& e) {
-        set_error(context, e.what());
+        set_error(scratch, e.what());
         return errval;
     } catch (...) {
-        set_error(context, "unknown exception");
+        set_error(scratch, "unknown exception");
+        return errval;
+    }
+}
+
+template <typename T, typename F>
+auto handle_exceptions(abieos_context* context, T errval, F f) noexcept -> decltype(f()) {
+    if (!context)
         return errval;
+    return handle_exceptions(context, context->scratch, errval, f);
+}
+
+// Lends a scratch from the context's pool to the calling thread
+struct borrowed_scratch {
+    abieos_context* context;
+    conversion_scratch* scratch = nullptr;
+
+    explicit borrowed_scratch(abieos_context* context) : context{context} {
+        std::lock_guard lock{context->pool_mutex};
+        if (context->free_scratch.empty()) {
+            context->free_scratch.reserve(context->scratch_pool.size() + 1);
+            scratch = &context->scratch_pool.emplace_back(context);
+        } else {
+            scratch = context->free_scratch.back();
+            context->free_scratch.pop_back();
+        }
+    }
+
+    borrowed_scratch(const borrowed_scratch&) = delete;
+
+    ~borrowed_scratch() {
+        std::lock_guard lock{context->pool_mutex};
+        context->free_scratch.push_back(scratch); // capacity was reserved when scratch was created
+    }
+};
+
+// Finds the abi in force at height
+const abi_ptr& get_abi(conversion_scratch& scratch, uint64_t contract, uint32_t height = latest_block) {
+    auto& contracts = scratch.snapshot->contracts;
+    auto contract_it = contracts.find(::abieos::name{contract});
+    if (contract_it == contracts.end())
+        throw std::runtime_error("contract \"" + name_to_string(contract) + "\" is not loaded");
+    auto& history = contract_it->second;
+    auto version = std::upper_bound(history.begin(), history.end(), height,
+                                    [](uint32_t height, const abi_version& v) { return height < v.height; });
+    if (version == history.begin())
+        throw std::runtime_error("contract \"" + name_to_string(contract) + "\" has no abi at block " +
+                                 std::to_string(height));
+    return std::prev(version)->abi;
+}
+
+// An abi parsed as far as compiling needs. Binary abis are read in place; json abis are parsed into def first.
+struct parsed_abi {
+    abi_def def{};
+    abi_view view{};
+    hooked_string error{}; // why a json abi failed to parse, if a serializer said
+};
+
+bool parse_abi(parsed_abi& abi, bool binary, std::string_view bytes) {
+    if (binary) {
+        read_abi_view(abi.view, {bytes.data(), bytes.data() + bytes.size()});
+        return true;
+    }
+    if (!json_to_native(abi.def, bytes, abi.error))
+        return false;
+    abi.view = make_abi_view(abi.def);
+    return true;
+}
+
+// Evicts abi's contract unless a conversion has it pinned. Requires registry->lru_mutex and abi.compile_mutex.
+bool evict(abieos_registry* registry, const registered_abi& abi) {
+    // Pairs with get_contract: either it sees ready cleared and compiles again, or this sees its pin and backs off
+    auto* c = abi.ready.exchange(nullptr, std::memory_order_seq_cst);
+    if (abi.pins.load(std::memory_order_seq_cst)) {
+        abi.ready.store(c, std::memory_order_release);
+        return false;
+    }
+    abi.compiled.reset();
+    abi.evicted = true;
+    registry->compiled_abis.erase(&abi);
+    registry->compiled_bytes -= abi.compiled_size;
+    ++registry->evictions;
+    return true;
+}
+
+// Evicts least recently used contracts, other than keep's, until the registry is within its compiled limit
+void evict_to_limit(abieos_registry* registry, const registered_abi* keep) {
+    std::lock_guard lock{registry->lru_mutex};
+    if (!registry->compiled_limit || registry->compiled_bytes <= registry->compiled_limit)
+        return;
+    hooked_vector<std::pair<uint64_t, const registered_abi*>> lru;
+    lru.reserve(registry->compiled_abis.size());
+    for (auto* abi : registry->compiled_abis)
+        if (abi != keep)
+            lru.push_back({abi->last_used.load(std::memory_order_relaxed), abi});
+    std::sort(lru.begin(), lru.end());
+    for (auto [_, abi] : lru) {
+        if (registry->compiled_bytes <= registry->compiled_limit)
+            break;
+        std::unique_lock abi_lock{abi->compile_mutex, std::try_to_lock}; // skip any being compiled
+        if (abi_lock)
+            evict(registry, *abi);
+    }
+}
+
+// Compiles abi unless it's compiled already. view, if not null, is abi parsed. Doesn't evict; the caller must either
+// pin abi first or not use its contract.
+void compile(const registered_abi& abi, const abi_view* view = nullptr) {
+    auto* registry = abi.registry;
+    std::lock_guard lock{abi.compile_mutex};
+    if (abi.compiled)
+        return; // compiled by another thread, or eviction backed off
+    {
+        allocator_scope scope{&abi.compiled_hooks};
+        parsed_abi parsed{};
+        if (!view && !parse_abi(parsed, abi.binary, abi.bytes))
+            throw std::runtime_error("abi parse error");
+        abi.compiled.emplace(create_contract(view ? *view : parsed.view));
+    }
+    std::lock_guard lru_lock{registry->lru_mutex};
+    try {
+        registry->compiled_abis.insert(&abi);
+    } catch (...) {
+        abi.compiled.reset();
+        throw;
+    }
+    abi.compiled_size = abi.compiled_hooks.bytes_in_use.load(std::memory_order_relaxed);
+    abi.serial = ++registry->compiles;
+    registry->compiled_bytes += abi.compiled_size;
+    if (abi.evicted)
+        ++registry->recompiles;
+    abi.last_used.store(registry->clock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    abi.ready.store(&*abi.compiled, std::memory_order_release);
+}
+
+// Pins abi until the end of the call and returns its contract, compiling it if it was never compiled or was evicted
+const contract& get_contract(conversion_scratch& scratch, const registered_abi& abi) {
+    auto* registry = abi.registry;
+    if (scratch.pinned != &abi) {
+        unpin(scratch);
+        abi.pins.fetch_add(1, std::memory_order_seq_cst);
+        scratch.pinned = &abi;
+    }
+    auto now = registry->clock.load(std::memory_order_relaxed);
+    if (abi.last_used.load(std::memory_order_relaxed) != now)
+        abi.last_used.store(now, std::memory_order_relaxed);
+    if (auto* c = abi.ready.load(std::memory_order_seq_cst))
+        return *c;
+    compile(abi);
+    evict_to_limit(registry, &abi);
+    return *abi.compiled; // it's pinned, so it stays
+}
+
+const contract& get_contract(conversion_scratch& scratch, uint64_t contract, uint32_t height = latest_block) {
+    return get_contract(scratch, *get_abi(scratch, contract, height));
+}
+
+const abi_type& get_type(conversion_scratch& scratch, uint64_t contract, const char* type,
+                         uint32_t height = latest_block) {
+    return get_type(get_contract(scratch, contract, height), type);
+}
+
+// Finds a live abi set from exactly these bytes, preferring one with a mapped contract. Requires writer_mutex.
+abi_ptr find_cached_abi(abieos_registry* registry, uint64_t hash, bool binary, std::string_view bytes) {
+    abi_ptr result;
+    auto it = registry->abi_cache.find(hash);
+    if (it != registry->abi_cache.end())
+        for (auto& entry : it->second)
+            if (auto abi = entry.lock(); abi && abi->binary == binary && abi->bytes == bytes) {
+                if (abi->mapped)
+                    return abi;
+                if (!result)
+                    result = std::move(abi);
+            }
+    return result;
+}
+
+// Requires writer_mutex
+void cache_abi(abieos_registry* registry, const abi_ptr& abi) {
+    auto expired = [](const std::weak_ptr<const registered_abi>& entry) { return entry.expired(); };
+    auto& entries = registry->abi_cache[abi->hash];
+    entries.erase(std::remove_if(entries.begin(), entries.end(), expired), entries.end());
+    entries.push_back(abi);
+    if (registry->abi_cache.size() < registry->abi_cache_sweep)
+        return;
+    for (auto it = registry->abi_cache.begin(); it != registry->abi_cache.end();) {
+        it->second.erase(std::remove_if(it->second.begin(), it->second.end(), expired), it->second.end());
+        it = it->second.empty() ? registry->abi_cache.erase(it) : std::next(it);
+    }
+    registry->abi_cache_sweep = std::max<size_t>(64, registry->abi_cache.size() * 2);
+}
+
+// Requires writer_mutex
+void publish(abieos_registry* registry, std::shared_ptr<registry_snapshot> next) {
+    std::atomic_store(&registry->current, snapshot_ptr{std::move(next)});
+    registry->generation.fetch_add(1, std::memory_order_release);
+}
+
+// Publishes a snapshot in which abi is in force from height, replacing any version at that height. Without a height,
+// abi replaces the contract's whole history. Does nothing if the history wouldn't change, so type handles stay valid
+// when an identical abi is set again. Requires writer_mutex.
+void publish_contract(abieos_registry* registry, name contract, abi_ptr abi, std::optional<uint32_t> height) {
+    auto by_height = [](const abi_version& v, uint32_t height) { return v.height < height; };
+    auto current = std::atomic_load(&registry->current);
+    auto it = current->contracts.find(contract);
+    if (it != current->contracts.end()) {
+        auto& history = it->second;
+        if (!height && history.size() == 1 && !history[0].height && history[0].abi == abi)
+            return;
+        auto pos = std::lower_bound(history.begin(), history.end(), height.value_or(0), by_height);
+        if (height && pos != history.end() && pos->height == *height && pos->abi == abi)
+            return;
+    }
+    auto next = std::allocate_shared<registry_snapshot>(context_allocator<registry_snapshot>{}, *current);
+    auto& history = next->contracts[contract];
+    if (!height)
+        history.clear();
+    auto pos = std::lower_bound(history.begin(), history.end(), height.value_or(0), by_height);
+    if (pos != history.end() && pos->height == height.value_or(0))
+        pos->abi = std::move(abi);
+    else
+        history.insert(pos, {height.value_or(0), std::move(abi)});
+    publish(registry, std::move(next));
+}
+
+// Publishes an abi to the context's registry; see publish_contract. bytes is the raw abi, json or binary. It's only
+// parsed and checked here; compiling waits until a conversion needs the contract. If the registry already has an abi
+// set from identical bytes, it's shared and the bytes aren't parsed at all.
+bool set_contract(abieos_context* context, name contract, std::optional<uint32_t> height, bool binary,
+                  std::string_view bytes) {
+    auto* registry = context->registry.registry;
+    allocator_scope scope{&registry->hooks};
+    auto hash = abi_hash(bytes);
+    {
+        std::lock_guard lock{registry->writer_mutex};
+        if (auto abi = find_cached_abi(registry, hash, binary, bytes)) {
+            publish_contract(registry, contract, std::move(abi), height);
+            return true;
+        }
+    }
+    parsed_abi parsed{};
+    if (!parse_abi(parsed, binary, bytes)) {
+        if (!parsed.error.empty())
+            set_error(context->scratch, parsed.error.c_str());
+        return false;
+    }
+    check_abi(parsed.view);
+    abi_ptr abi =
+        std::allocate_shared<registered_abi>(context_allocator<registered_abi>{}, registry, binary, hash, bytes);
+    std::lock_guard lock{registry->writer_mutex};
+    if (auto cached = find_cached_abi(registry, hash, binary, bytes))
+        abi = std::move(cached); // another thread set the same bytes first
+    else
+        cache_abi(registry, abi);
+    publish_contract(registry, contract, std::move(abi), height);
+    return true;
+}
+
+// Registry file layout, in host byte order: snapshot_header; num_abis snapshot_abi, num_contracts snapshot_contract and
+// num_versions snapshot_version; then the abis' bytes, then the images of their contracts. Everything is found by
+// offset or index, so a mapped file is used in place, images included.
+struct snapshot_header {
+    char magic[8];
+    uint32_t format;
+    uint32_t num_abis;
+    uint32_t num_contracts;
+    uint32_t num_versions;
+    uint64_t size; // of the whole file
+};
+
+struct snapshot_abi {
+    uint64_t offset; // of the bytes, from the start of the file
+    uint64_t size;
+    uint64_t hash; // abi_hash(bytes)
+    uint32_t binary;
+    uint32_t reserved;
+    uint64_t contract_offset; // of the contract's image, aligned to 8; 0 if there's none
+    uint64_t contract_size;
+};
+
+struct snapshot_contract {
+    uint64_t name;
+    uint32_t first_version;
+    uint32_t num_versions; // ordered by height
+};
+
+struct snapshot_version {
+    uint32_t height;
+    uint32_t abi;
+};
+
+constexpr char snapshot_magic[8] = {'a', 'b', 'i', 'e', 'o', 's', 'R', 'F'};
+constexpr uint32_t snapshot_format = 2; // also catches files written with the other byte order
+
+// Calls first(i) for each i below count, then between() once, then second(i) for each i below count. The work is
+// shared by up to `threads` threads (0 for one per core) including this one; they start once and wait for each other
+// around between(), which runs on this thread. first and second must not throw; if between throws, second is skipped
+// and the exception propagates once the threads have finished.
+template <typename First, typename Between, typename Second>
+void parallel_for(size_t count, unsigned threads, First first, Between between, Second second) {
+    std::atomic<size_t> next_first{0};
+    std::atomic<size_t> next_second{0};
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t first_done = 0;     // threads which are done with first; guarded by mutex
+    bool second_ready = false; // guarded by mutex
+    auto run = [&](std::atomic<size_t>& next, auto& f) {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;)
+            f(i);
+    };
+    auto work = [&] {
+        run(next_first, first);
+        std::unique_lock lock{mutex};
+        ++first_done;
+        cv.notify_all();
+        cv.wait(lock, [&] { return second_ready; });
+        lock.unlock();
+        run(next_second, second);
+    };
+    if (!threads)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    hooked_vector<std::thread> pool;
+    try {
+        for (size_t i = 1; i < std::min<size_t>(threads, count); ++i)
+            pool.emplace_back(work);
+    } catch (...) {
+        // the threads which did start, and this one, do all the work
+    }
+    run(next_first, first);
+    std::exception_ptr error;
+    {
+        std::unique_lock lock{mutex};
+        cv.wait(lock, [&] { return first_done == pool.size(); });
+        try {
+            between();
+        } catch (...) {
+            error = std::current_exception();
+            next_second = count;
+        }
+        second_ready = true;
+    }
+    cv.notify_all();
+    run(next_second, second);
+    for (auto& t : pool)
+        t.join();
+    if (error)
+        std::rethrow_exception(error);
+}
+
+// Sets many contracts' abis at once. Only the abis which are new to the registry, and the first of each set of
+// identical abis in the batch, are parsed, checked and optionally compiled; that happens in parallel and without
+// writer_mutex, which is only held to look up and then publish, once. Returns the number of abis which failed;
+// errors[i] receives the message of abis[i], or stays empty.
+size_t set_contracts(abieos_context* context, const abieos_abi_bin* abis, size_t count, unsigned threads,
+                     bool compile_abis, hooked_vector<hooked_string>& errors) {
+    auto* registry = context->registry.registry;
+    errors.clear();
+    errors.resize(count);
+    hooked_vector<uint64_t> hashes(count);
+    hooked_vector<abi_ptr> results(count);
+    hooked_vector<size_t> same_as(count); // index of an identical abi earlier in the batch, or count
+    auto bytes = [&](size_t i) { return abis[i].data ? std::string_view{abis[i].data, abis[i].size} : ""; };
+    auto hash = [&](size_t i) { hashes[i] = abi_hash(bytes(i)); };
+    auto find_new = [&] {
+        allocator_scope scope{&registry->hooks};
+        std::lock_guard lock{registry->writer_mutex};
+        hooked_map<uint64_t, hooked_vector<size_t>> batch;
+        for (size_t i = 0; i < count; ++i) {
+            same_as[i] = count;
+            if (bytes(i).empty())
+                continue;
+            if ((results[i] = find_cached_abi(registry, hashes[i], true, bytes(i))))
+                continue;
+            auto& candidates = batch[hashes[i]];
+            for (auto j : candidates)
+                if (bytes(j) == bytes(i))
+                    same_as[i] = j;
+            if (same_as[i] == count)
+                candidates.push_back(i);
+        }
+    };
+    auto import = [&](size_t i) {
+        if (results[i] || same_as[i] != count)
+            return;
+        try {
+            allocator_scope scope{&registry->hooks};
+            if (bytes(i).empty())
+                throw std::runtime_error("no data");
+            parsed_abi parsed{};
+            parse_abi(parsed, true, bytes(i));
+            check_abi(parsed.view);
+            auto abi = std::allocate_shared<registered_abi>(context_allocator<registered_abi>{}, registry, true,
+                                                            hashes[i], bytes(i));
+            if (compile_abis)
+                compile(*abi, &parsed.view);
+            results[i] = std::move(abi);
+        } catch (std::exception& e) {
+            errors[i] = e.what();
+        } catch (...) {
+            errors[i] = "unknown exception";
+        }
+    };
+    parallel_for(count, threads, hash, find_new, import);
+
+    size_t failed = 0;
+    allocator_scope scope{&registry->hooks};
+    std::unique_lock lock{registry->writer_mutex};
+    auto next = std::allocate_shared<registry_snapshot>(context_allocator<registry_snapshot>{},
+                                                        *std::atomic_load(&registry->current));
+    for (size_t i = 0; i < count; ++i) {
+        auto& abi = results[i];
+        if (same_as[i] != count) {
+            abi = results[same_as[i]];
+            errors[i] = errors[same_as[i]];
+        }
+        if (!abi) {
+            ++failed;
+            continue;
+        }
+        if (auto cached = find_cached_abi(registry, abi->hash, abi->binary, abi->bytes))
+            abi = std::move(cached); // another thread set the same bytes first
+        else
+            cache_abi(registry, abi);
+        auto& history = next->contracts[name{abis[i].contract}];
+        history.clear();
+        history.push_back({0, abi});
+    }
+    if (failed < count)
+        publish(registry, std::move(next));
+    lock.unlock();
+    if (compile_abis)
+        evict_to_limit(registry, nullptr);
+    return failed;
+}
+
+// The image of abi's contract: the one it has, or else one compiled just for this. Empty if abi doesn't compile; a
+// process which loads it finds out why when it compiles abi itself.
+hooked_string contract_image_of(const registered_abi& abi) {
+    {
+        std::lock_guard lock{abi.compile_mutex}; // keeps compiled from being evicted
+        auto& c = abi.mapped ? abi.mapped : abi.compiled;
+        if (c)
+            return hooked_string{c->bytes()};
+    }
+    try {
+        parsed_abi parsed{};
+        if (!parse_abi(parsed, abi.binary, abi.bytes))
+            return {};
+        return hooked_string{create_contract(parsed.view).bytes()};
+    } catch (std::runtime_error&) {
+        return {};
+    }
+}
+
+// Writes the abis in the context's snapshot, and their contracts, to file
+bool write_snapshot(conversion_scratch& scratch, FILE* file) {
+    hooked_map<const registered_abi*, uint32_t> abi_index;
+    hooked_vector<const registered_abi*> abis;
+    hooked_vector<snapshot_contract> contracts;
+    hooked_vector<snapshot_version> versions;
+    for (auto& [contract, history] : scratch.snapshot->contracts) {
+        contracts.push_back({contract.value, uint32_t(versions.size()), uint32_t(history.size())});
+        for (auto& version : history) {
+            auto [it, inserted] = abi_index.try_emplace(version.abi.get(), abis.size());
+            if (inserted)
+                abis.push_back(version.abi.get());
+            versions.push_back({version.height, it->second});
+        }
+    }
+
+    snapshot_header header{};
+    memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+    header.format = snapshot_format;
+    header.num_abis = abis.size();
+    header.num_contracts = contracts.size();
+    header.num_versions = versions.size();
+    uint64_t offset = sizeof(header) + abis.size() * sizeof(snapshot_abi) +
+                      contracts.size() * sizeof(snapshot_contract) + versions.size() * sizeof(snapshot_version);
+    hooked_vector<snapshot_abi> abi_table;
+    for (auto* abi : abis) {
+        abi_table.push_back({offset, abi->bytes.size(), abi->hash, abi->binary, 0, 0, 0});
+        offset += abi->bytes.size();
+    }
+    hooked_vector<hooked_string> images;
+    images.reserve(abis.size());
+    for (size_t i = 0; i < abis.size(); ++i) {
+        auto& image = images.emplace_back(contract_image_of(*abis[i]));
+        if (image.empty())
+            continue;
+        offset = (offset + 7) / 8 * 8;
+        abi_table[i].contract_offset = offset;
+        abi_table[i].contract_size = image.size();
+        offset += image.size();
+    }
+    header.size = offset;
+
+    bool ok = true;
+    uint64_t written = 0;
+    auto write = [&](const void* data, size_t size) {
+        ok = ok && fwrite(data, 1, size, file) == size;
+        written += size;
+    };
+    write(&header, sizeof(header));
+    write(abi_table.data(), abi_table.size() * sizeof(snapshot_abi));
+    write(contracts.data(), contracts.size() * sizeof(snapshot_contract));
+    write(versions.data(), versions.size() * sizeof(snapshot_version));
+    for (auto* abi : abis)
+        write(abi->bytes.data(), abi->bytes.size());
+    static const char padding[8] = {};
+    for (size_t i = 0; i < abis.size(); ++i) {
+        if (images[i].empty())
+            continue;
+        write(padding, abi_table[i].contract_offset - written);
+        write(images[i].data(), images[i].size());
+    }
+    return ok;
+}
+
+// Writes the abis in the context's snapshot to path. Writes a temporary file and renames it over path, so a process
+// which has the old file mapped keeps a consistent view.
+void save_snapshot(conversion_scratch& scratch, const char* path) {
+    std::string tmp_path = path + std::string{".tmp"};
+    std::unique_ptr<FILE, int (*)(FILE*)> file{fopen(tmp_path.c_str(), "wb"), fclose};
+    if (!file)
+        throw std::runtime_error("can't create " + tmp_path + ": " + strerror(errno));
+    bool ok = write_snapshot(scratch, file.get());
+    ok = fclose(file.release()) == 0 && ok;
+    if (!ok || rename(tmp_path.c_str(), path)) {
+        auto error = errno;
+        remove(tmp_path.c_str());
+        throw std::runtime_error("can't write " + std::string{path} + ": " + strerror(error));
+    }
+}
+
+// The tables of a mapped registry file, once check_snapshot has found them consistent
+struct snapshot_view {
+    snapshot_header header;
+    const snapshot_abi* abis;
+    const snapshot_contract* contracts;
+    const snapshot_version* versions;
+    hooked_vector<const contract_image*> images{}; // of abis[i]'s contract; null if none, or if another build wrote it
+};
+
+// Checks that the structure of a file written by write_snapshot is consistent, and that its contract images are, but
+// doesn't parse or check its abis; that waits until they're compiled, if they need to be.
+snapshot_view check_snapshot(const mapped_file& file, const char* path) {
+    auto corrupt = [&] { return std::runtime_error(std::string{path} + " is corrupt"); };
+    snapshot_view view;
+    auto& header = view.header;
+    if (file.size < sizeof(header))
+        throw corrupt();
+    memcpy(&header, file.data, sizeof(header));
+    if (memcmp(header.magic, snapshot_magic, sizeof(header.magic)))
+        throw std::runtime_error(std::string{path} + " is not an abieos registry file");
+    if (header.format != snapshot_format)
+        throw std::runtime_error(std::string{path} + " has an unsupported format");
+    uint64_t tables_end = sizeof(header) + uint64_t(header.num_abis) * sizeof(snapshot_abi) +
+                          uint64_t(header.num_contracts) * sizeof(snapshot_contract) +
+                          uint64_t(header.num_versions) * sizeof(snapshot_version);
+    if (header.size != file.size || tables_end > file.size)
+        throw corrupt();
+    view.abis = reinterpret_cast<const snapshot_abi*>(file.data + sizeof(header));
+    view.contracts = reinterpret_cast<const snapshot_contract*>(view.abis + header.num_abis);
+    view.versions = reinterpret_cast<const snapshot_version*>(view.contracts + header.num_contracts);
+    view.images.reserve(header.num_abis);
+    for (uint32_t i = 0; i < header.num_abis; ++i) {
+        auto& a = view.abis[i];
+        if (a.offset < tables_end || a.size > file.size - a.offset)
+            throw corrupt();
+        auto& image = view.images.emplace_back();
+        if (!a.contract_size)
+            continue;
+        if (a.contract_offset < tables_end || a.contract_offset % 8 || a.contract_size > file.size - a.contract_offset)
+            throw corrupt();
+        try {
+            image = check_contract_image({file.data + a.contract_offset, size_t(a.contract_size)});
+        } catch (std::runtime_error&) {
+            throw corrupt();
+        }
+    }
+    for (uint32_t i = 0; i < header.num_versions; ++i)
+        if (view.versions[i].abi >= header.num_abis)
+            throw corrupt();
+    for (uint32_t i = 0; i < header.num_contracts; ++i) {
+        auto& c = view.contracts[i];
+        if (!c.num_versions || uint64_t(c.first_version) + c.num_versions > header.num_versions)
+            throw corrupt();
+        for (uint32_t j = 1; j < c.num_versions; ++j)
+            if (view.versions[c.first_version + j - 1].height >= view.versions[c.first_version + j].height)
+                throw corrupt();
+    }
+    return view;
+}
+
+// Publishes the contracts of a checked registry file in one snapshot. They replace the histories of the same
+// contracts, or with replace_all, every contract. Requires writer_mutex.
+void publish_snapshot(abieos_registry* registry, const std::shared_ptr<const mapped_file>& file,
+                      const snapshot_view& view, bool replace_all) {
+    hooked_vector<abi_ptr> abis;
+    abis.reserve(view.header.num_abis);
+    for (uint32_t i = 0; i < view.header.num_abis; ++i) {
+        auto& a = view.abis[i];
+        std::string_view bytes{file->data + a.offset, size_t(a.size)};
+        auto abi = find_cached_abi(registry, a.hash, a.binary, bytes);
+        if (!abi || (!abi->mapped && view.images[i])) { // using the file's contract beats compiling one
+            abi = std::allocate_shared<registered_abi>(context_allocator<registered_abi>{}, registry, a.binary, a.hash,
+                                                       bytes, file, view.images[i]);
+            cache_abi(registry, abi);
+        }
+        abis.push_back(std::move(abi));
+    }
+    auto next = replace_all ? std::allocate_shared<registry_snapshot>(context_allocator<registry_snapshot>{})
+                            : std::allocate_shared<registry_snapshot>(context_allocator<registry_snapshot>{},
+                                                                      *std::atomic_load(&registry->current));
+    for (uint32_t i = 0; i < view.header.num_contracts; ++i) {
+        auto& c = view.contracts[i];
+        auto& history = next->contracts[name{c.name}];
+        history.clear();
+        for (uint32_t j = c.first_version; j < c.first_version + c.num_versions; ++j)
+            history.push_back({view.versions[j].height, abis[view.versions[j].abi]});
+    }
+    publish(registry, std::move(next));
+}
+
+// Maps a file written by save_snapshot and publishes its contracts, replacing their histories
+void load_snapshot(abieos_context* context, const char* path) {
+    auto* registry = context->registry.registry;
+    allocator_scope scope{&registry->hooks};
+    auto file = std::allocate_shared<mapped_file>(context_allocator<mapped_file>{}, path);
+    auto view = check_snapshot(*file, path);
+    std::lock_guard lock{registry->writer_mutex};
+    publish_snapshot(registry, file, view, false);
+}
+
+std::string publication_name(std::string_view name, uint64_t generation) {
+    return std::string{name} + "." + std::to_string(generation);
+}
+
+// Maps the control object of a shared registry, creating it if it doesn't exist
+shared_registry_control* open_shared_control(const char* name) {
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        throw std::runtime_error("can't open " + std::string{name} + ": " + strerror(errno));
+    struct stat st;
+    void* p = MAP_FAILED;
+    bool sized = fstat(fd, &st) == 0 && (st.st_size || ftruncate(fd, sizeof(shared_registry_control)) == 0);
+    if (sized && (!st.st_size || size_t(st.st_size) >= sizeof(shared_registry_control)))
+        p = mmap(nullptr, sizeof(shared_registry_control), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    auto error = errno;
+    close(fd);
+    if (p == MAP_FAILED && sized)
+        throw std::runtime_error(std::string{name} + " is not a shared abieos registry");
+    if (p == MAP_FAILED)
+        throw std::runtime_error("can't map " + std::string{name} + ": " + strerror(error));
+    auto* control = static_cast<shared_registry_control*>(p);
+    static const char zeros[sizeof(control->magic)] = {};
+    if (!memcmp(control->magic, zeros, sizeof(zeros)))
+        memcpy(control->magic, shared_registry_magic, sizeof(control->magic)); // just created
+    if (memcmp(control->magic, shared_registry_magic, sizeof(control->magic))) {
+        munmap(p, sizeof(shared_registry_control));
+        throw std::runtime_error(std::string{name} + " is not a shared abieos registry");
+    }
+    return control;
+}
+
+// Writes the context's snapshot as a new publication of a shared registry, then makes it current unless a publication
+// reserved later already is. Attached registries which still use the replaced publication keep it mapped after it is
+// unlinked.
+void publish_shared(conversion_scratch& scratch, const char* name) {
+    std::unique_ptr<shared_registry_control, void (*)(shared_registry_control*)> control{
+        open_shared_control(name), [](shared_registry_control* p) { munmap(p, sizeof(*p)); }};
+    auto generation = control->reserved.fetch_add(1, std::memory_order_acq_rel) + 1;
+    auto publication = publication_name(name, generation);
+    int fd = shm_open(publication.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    std::unique_ptr<FILE, int (*)(FILE*)> file{fd < 0 ? nullptr : fdopen(fd, "wb"), fclose};
+    if (!file) {
+        auto error = errno;
+        if (fd >= 0) {
+            close(fd);
+            shm_unlink(publication.c_str());
+        }
+        throw std::runtime_error("can't create " + publication + ": " + strerror(error));
+    }
+    bool ok = write_snapshot(scratch, file.get());
+    ok = fclose(file.release()) == 0 && ok;
+    if (!ok) {
+        auto error = errno;
+        shm_unlink(publication.c_str());
+        throw std::runtime_error("can't write " + publication + ": " + strerror(error));
+    }
+    auto replaced = control->generation.load(std::memory_order_acquire);
+    while (replaced < generation &&
+           !control->generation.compare_exchange_weak(replaced, generation, std::memory_order_acq_rel))
+        ;
+    shm_unlink(publication_name(name, replaced < generation ? replaced : generation).c_str());
+}
+
+// Reloads an attached registry if there is a newer publication. Costs two atomic loads when there isn't.
+void sync_shared(abieos_registry* registry) {
+    auto* control = registry->shared_control.load(std::memory_order_acquire);
+    if (!control || control->generation.load(std::memory_order_acquire) ==
+                        registry->shared_generation.load(std::memory_order_acquire))
+        return;
+    allocator_scope scope{&registry->hooks};
+    std::lock_guard lock{registry->writer_mutex};
+    for (;;) {
+        auto generation = control->generation.load(std::memory_order_acquire);
+        if (generation == registry->shared_generation.load(std::memory_order_relaxed))
+            return;
+        auto publication = publication_name(registry->shared_name, generation);
+        std::shared_ptr<const mapped_file> file;
+        try {
+            file = std::allocate_shared<mapped_file>(context_allocator<mapped_file>{}, publication.c_str(), true);
+        } catch (...) {
+            if (control->generation.load(std::memory_order_acquire) != generation)
+                continue; // replaced and unlinked before we could open it
+            throw;
+        }
+        publish_snapshot(registry, file, check_snapshot(*file, publication.c_str()), true);
+        registry->shared_generation.store(generation, std::memory_order_release);
+        return;
+    }
+}
+
+void attach_shared(abieos_context* context, const char* name) {
+    auto* registry = context->registry.registry;
+    {
+        allocator_scope scope{&registry->hooks};
+        auto file = std::allocate_shared<mapped_file>(context_allocator<mapped_file>{}, name, true);
+        if (file->size < sizeof(shared_registry_control) ||
+            memcmp(file->data, shared_registry_magic, sizeof(shared_registry_magic)))
+            throw std::runtime_error(std::string{name} + " is not a shared abieos registry");
+        std::lock_guard lock{registry->writer_mutex};
+        if (registry->shared_control_file)
+            throw std::runtime_error("registry is already attached to " + std::string{registry->shared_name});
+        registry->shared_name.assign(name);
+        registry->shared_control_file = file;
+        registry->shared_control.store(reinterpret_cast<const shared_registry_control*>(file->data),
+                                       std::memory_order_release);
+    }
+    sync_shared(registry);
+}
+
+// Removes a shared registry's control object and its latest publication
+void unlink_shared(const char* name) {
+    std::unique_ptr<shared_registry_control, void (*)(shared_registry_control*)> control{
+        open_shared_control(name), [](shared_registry_control* p) { munmap(p, sizeof(*p)); }};
+    shm_unlink(publication_name(name, control->generation.load(std::memory_order_acquire)).c_str());
+    if (shm_unlink(name))
+        throw std::runtime_error("can't unlink " + std::string{name} + ": " + strerror(errno));
+}
+
+bool is_stale(conversion_scratch& scratch, const abieos_type_handle& handle) {
+    auto& contracts = scratch.snapshot->contracts;
+    auto it = contracts.find(handle.contract);
+    return it == contracts.end() || it->second.back().abi != handle.abi;
+}
+
+const abi_type& get_type(abieos_context* context, const abieos_type_handle* handle) {
+    if (!handle)
+        throw std::runtime_error("type handle is null");
+    if (!handle->type || is_stale(context->scratch, *handle))
+        throw std::runtime_error("type handle is stale; the contract's abi was replaced");
+    auto& c = get_contract(context->scratch, *handle->abi);
+    if (handle->serial != handle->abi->serial) { // the contract was evicted and compiled again
+        handle->type = &get_type(c, handle->type_name);
+        handle->serial = handle->abi->serial;
+    }
+    return *handle->type;
+}
+
+// Records a failure which the engine reported through state.error
+template <typename State>
+bool conversion_failed(conversion_scratch& scratch, const State& state) {
+    if (!state.error.empty())
+        set_error(scratch, state.error.c_str());
+    return false;
+}
+
+// Parses json into scratch.json_to_bin; use get_bin_size and write_bin to retrieve the result
+bool json_to_bin(conversion_scratch& scratch, const abi_type& t, const char* json) {
+    scratch.last_error = "json parse error";
+    if (!json_to_bin(scratch.json_to_bin, scratch.mutable_json, &t, json))
+        return conversion_failed(scratch, scratch.json_to_bin);
+    return true;
+}
+
+// Appends the conversion of json to bin
+bool json_to_bin(conversion_scratch& scratch, hooked_vector<char>& bin, const abi_type& t, const char* json) {
+    scratch.last_error = "json parse error";
+    if (!json_to_bin(bin, scratch.json_to_bin, scratch.mutable_json, &t, json))
+        return conversion_failed(scratch, scratch.json_to_bin);
+    return true;
+}
+
+// Replaces context->result_bin with the conversion of json
+bool json_to_result_bin(abieos_context* context, const abi_type& t, const char* json) {
+    reset_buffer(context->scratch, context->result_bin);
+    return json_to_bin(context->scratch, context->result_bin, t, json);
+}
+
+// Converts binary to json. Appends to stream.
+bool bin_to_json(conversion_scratch& scratch, const abi_type& t, const char* data, size_t size, output_stream& stream) {
+    scratch.last_error = "binary decode error";
+    auto& state = scratch.bin_to_json;
+    if (!data || !size) {
+        report_error(state, "no data");
+        return conversion_failed(scratch, state);
+    }
+    if (!bin_to_json(state, {data, data + size}, &t, stream))
+        return conversion_failed(scratch, state);
+    if (state.bin.pos != state.bin.end) {
+        report_error(state, "Extra data");
+        return conversion_failed(scratch, state);
+    }
+    return true;
+}
+
+// Converts binary to json, storing the result in dest
+bool bin_to_json(conversion_scratch& scratch, const abi_type& t, const char* data, size_t size, hooked_string& dest) {
+    reset_buffer(scratch, dest);
+    output_stream stream{dest};
+    bool ok = bin_to_json(scratch, t, data, size, stream);
+    stream.finish();
+    return ok;
+}
+
+abieos_result* make_result(abieos_context* context) { return context->results.slab->alloc(); }
+
+abieos_result* json_to_bin_result(abieos_context* context, conversion_scratch& scratch, const abi_type& t,
+                                  const char* json) {
+    if (!json_to_bin(scratch, t, json))
+        return nullptr;
+    auto* result = make_result(context);
+    try {
+        result->data.resize(get_bin_size(scratch.json_to_bin));
+        write_bin(scratch.json_to_bin, result->data.data());
+    } catch (...) {
+        abieos_result_release(result);
+        throw;
+    }
+    return result;
+}
+
+abieos_result* bin_to_json_result(abieos_context* context, conversion_scratch& scratch, const abi_type& t,
+                                  const char* data, size_t size) {
+    auto* result = make_result(context);
+    try {
+        if (!bin_to_json(scratch, t, data, size, result->data)) {
+            abieos_result_release(result);
+            return nullptr;
+        }
+    } catch (...) {
+        abieos_result_release(result);
+        throw;
+    }
+    return result;
+}
+
+// Runs a conversion on a borrowed scratch. On failure, *error (if not null) receives a result holding the message.
+template <typename F>
+abieos_result* run_concurrent(abieos_context* context, abieos_result** error, F f) noexcept {
+    if (error)
+        *error = nullptr;
+    if (!context)
+        return nullptr;
+    allocator_scope scope{&context->hooks()};
+    try {
+        borrowed_scratch borrowed{context};
+        auto& scratch = *borrowed.scratch;
+        auto* result = handle_exceptions(context, scratch, (abieos_result*)nullptr, [&] { return f(scratch); });
+        if (!result && error) {
+            *error = make_result(context);
+            (*error)->data = scratch.last_error;
+        }
+        return result;
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+extern "C" abieos_context* abieos_create() { return abieos_create_with_allocator(nullptr, nullptr, nullptr); }
+
+// Creates a context. Uses registry if it isn't null; otherwise creates a private registry which allocates through the
+// same functions as the context.
+abieos_context* create_context(abieos_alloc_fn alloc_fn, abieos_free_fn free_fn, void* user,
+                               abieos_registry* registry) {
+    if (!alloc_fn != !free_fn)
+        return nullptr;
+    result_slab* slab = nullptr;
+    bool own_registry = !registry;
+    try {
+        slab = new result_slab;
+        slab->hooks.alloc_fn = alloc_fn;
+        slab->hooks.free_fn = free_fn;
+        slab->hooks.user = user;
+        allocator_scope scope{&slab->hooks};
+        if (own_registry)
+            registry = new abieos_registry{&slab->hooks};
+        else
+            registry->refs.fetch_add(1, std::memory_order_relaxed);
+    } catch (...) {
+        delete slab;
+        return nullptr;
     }
+    try {
+        allocator_scope scope{&slab->hooks};
+        return new abieos_context{slab, registry, own_registry};
+    } catch (...) {
+        abieos_registry_s::release(registry);
+        result_slab::release(slab, nullptr);
+        return nullptr;
+    }
+}
+
+extern "C" abieos_context* abieos_create_with_allocator(abieos_alloc_fn alloc_fn, abieos_free_fn free_fn, void* user) {
+    return create_context(alloc_fn, free_fn, user, nullptr);
 }
 
-extern "C" abieos_context* abieos_create() {
+extern "C" abieos_registry* abieos_registry_create() {
     try {
-        return new abieos_context{};
+        return new abieos_registry{nullptr};
     } catch (...) {
         return nullptr;
     }
 }
 
+extern "C" void abieos_registry_release(abieos_registry* registry) { abieos_registry_s::release(registry); }
+
+extern "C" abieos_context* abieos_create_with_registry(abieos_registry* registry) {
+    if (!registry)
+        return nullptr;
+    return create_context(nullptr, nullptr, nullptr, registry);
+}
+
+extern "C" abieos_registry* abieos_get_registry(abieos_context* context) {
+    return context ? context->registry.registry : nullptr;
+}
+
+extern "C" abieos_bool abieos_registry_set_compiled_limit(abieos_registry* registry, size_t bytes) {
+    if (!registry)
+        return false;
+    try {
+        allocator_scope scope{&registry->hooks};
+        {
+            std::lock_guard lock{registry->lru_mutex};
+            registry->compiled_limit = bytes;
+        }
+        evict_to_limit(registry, nullptr);
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+extern "C" abieos_bool abieos_registry_get_stats(abieos_registry* registry, abieos_registry_stats* stats) {
+    if (!registry || !stats)
+        return false;
+    std::lock_guard lock{registry->lru_mutex};
+    stats->compiled = registry->compiled_abis.size();
+    stats->compiled_bytes = registry->compiled_bytes;
+    stats->compiles = registry->compiles;
+    stats->recompiles = registry->recompiles;
+    stats->evictions = registry->evictions;
+    return true;
+}
+
+extern "C" void abieos_set_scratch_limit(abieos_context* context, size_t bytes) {
+    if (context)
+        context->scratch_limit.store(bytes, std::memory_order_relaxed);
+}
+
+extern "C" abieos_bool abieos_get_alloc_stats(abieos_context* context, abieos_alloc_stats* stats) {
+    if (!context || !stats)
+        return false;
+    *stats = {};
+    auto add = [&](const allocator_hooks& hooks) {
+        stats->allocations += hooks.allocations.load(std::memory_order_relaxed);
+        stats->deallocations += hooks.deallocations.load(std::memory_order_relaxed);
+        stats->bytes_allocated += hooks.bytes_allocated.load(std::memory_order_relaxed);
+        stats->bytes_in_use += hooks.bytes_in_use.load(std::memory_order_relaxed);
+    };
+    add(context->hooks());
+    if (context->private_registry)
+        add(context->registry.registry->hooks);
+    return true;
+}
+
 extern "C" void abieos_destroy(abieos_context* context) { delete context; }
 
 extern "C" const char* abieos_get_error(abieos_context* context) {
     if (!context)
         return "context is null";
-    return context->last_error;
+    return context->scratch.last_error;
 }
 
 extern "C" int abieos_get_bin_size(abieos_context* context) {
@@ -94,98 +1433,358 @@ extern "C" const char* abieos_name_to_string(abieos_context* context, uint64_t n
     });
 }
 
-extern "C" abieos_bool abieos_set_abi(abieos_context* context, uint64_t contract, const char* abi) {
+abieos_bool set_abi(abieos_context* context, uint64_t contract, std::optional<uint32_t> height, const char* abi) {
     fix_null_str(abi);
     return handle_exceptions(context, false, [&] {
-        context->last_error = "abi parse error";
-        abi_def def{};
-        if (!json_to_native(def, abi))
-            return false;
-        auto c = create_contract(def);
-        context->contracts.insert({name{contract}, std::move(c)});
-        return true;
+        context->scratch.last_error = "abi parse error";
+        return set_contract(context, name{contract}, height, false, abi);
     });
 }
 
-extern "C" abieos_bool abieos_set_abi_bin(abieos_context* context, uint64_t contract, const char* data, size_t size) {
+abieos_bool set_abi_bin(abieos_context* context, uint64_t contract, std::optional<uint32_t> height, const char* data,
+                        size_t size) {
     return handle_exceptions(context, false, [&] {
-        context->last_error = "abi parse error";
+        context->scratch.last_error = "abi parse error";
         if (!data || !size)
             throw std::runtime_error("no data");
-        abi_def def{};
-        if (!bin_to_native(def, {data, data + size}))
-            return false;
-        auto c = create_contract(def);
-        context->contracts.insert({name{contract}, std::move(c)});
-        return true;
+        return set_contract(context, name{contract}, height, true, {data, size});
     });
 }
 
-extern "C" abieos_bool abieos_set_abi_hex(abieos_context* context, uint64_t contract, const char* hex) {
+abieos_bool set_abi_hex(abieos_context* context, uint64_t contract, std::optional<uint32_t> height, const char* hex) {
     fix_null_str(hex);
     return handle_exceptions(context, false, [&] {
-        std::vector<char> data;
+        hooked_vector<char> data;
         boost::algorithm::unhex(hex, hex + strlen(hex), std::back_inserter(data));
-        return abieos_set_abi_bin(context, contract, data.data(), data.size());
+        return set_abi_bin(context, contract, height, data.data(), data.size());
+    });
+}
+
+extern "C" abieos_bool abieos_set_abi(abieos_context* context, uint64_t contract, const char* abi) {
+    return set_abi(context, contract, std::nullopt, abi);
+}
+
+extern "C" abieos_bool abieos_set_abi_bin(abieos_context* context, uint64_t contract, const char* data, size_t size) {
+    return set_abi_bin(context, contract, std::nullopt, data, size);
+}
+
+extern "C" abieos_bool abieos_set_abi_hex(abieos_context* context, uint64_t contract, const char* hex) {
+    return set_abi_hex(context, contract, std::nullopt, hex);
+}
+
+extern "C" abieos_bool abieos_set_abi_at(abieos_context* context, uint64_t contract, uint32_t height, const char* abi) {
+    return set_abi(context, contract, height, abi);
+}
+
+extern "C" abieos_bool abieos_set_abi_bin_at(abieos_context* context, uint64_t contract, uint32_t height,
+                                             const char* data, size_t size) {
+    return set_abi_bin(context, contract, height, data, size);
+}
+
+extern "C" abieos_bool abieos_set_abi_hex_at(abieos_context* context, uint64_t contract, uint32_t height,
+                                             const char* hex) {
+    return set_abi_hex(context, contract, height, hex);
+}
+
+extern "C" abieos_bool abieos_set_abis_bin(abieos_context* context, const abieos_abi_bin* abis, size_t count,
+                                           unsigned threads, abieos_bool compile, const char** errors) {
+    return handle_exceptions(context, false, [&] {
+        if (!abis && count)
+            throw std::runtime_error("abis is null");
+        auto failed = set_contracts(context, abis, count, threads, compile, context->bulk_errors);
+        if (errors)
+            for (size_t i = 0; i < count; ++i)
+                errors[i] = context->bulk_errors[i].empty() ? nullptr : context->bulk_errors[i].c_str();
+        if (failed)
+            throw std::runtime_error(std::to_string(failed) + " of " + std::to_string(count) + " abis failed");
+        return true;
+    });
+}
+
+extern "C" abieos_bool abieos_save_registry(abieos_context* context, const char* path) {
+    fix_null_str(path);
+    return handle_exceptions(context, false, [&] {
+        save_snapshot(context->scratch, path);
+        return true;
+    });
+}
+
+extern "C" abieos_bool abieos_load_registry(abieos_context* context, const char* path) {
+    fix_null_str(path);
+    return handle_exceptions(context, false, [&] {
+        load_snapshot(context, path);
+        return true;
+    });
+}
+
+extern "C" abieos_bool abieos_publish_shared_registry(abieos_context* context, const char* name) {
+    fix_null_str(name);
+    return handle_exceptions(context, false, [&] {
+        publish_shared(context->scratch, name);
+        return true;
+    });
+}
+
+extern "C" abieos_bool abieos_attach_shared_registry(abieos_context* context, const char* name) {
+    fix_null_str(name);
+    return handle_exceptions(context, false, [&] {
+        attach_shared(context, name);
+        return true;
+    });
+}
+
+extern "C" abieos_bool abieos_unlink_shared_registry(abieos_context* context, const char* name) {
+    fix_null_str(name);
+    return handle_exceptions(context, false, [&] {
+        unlink_shared(name);
+        return true;
     });
 }
 
 extern "C" const char* abieos_get_type_for_action(abieos_context* context, uint64_t contract, uint64_t action) {
-    return handle_exceptions(context, nullptr, [&] {
-        auto contract_it = context->contracts.find(::abieos::name{contract});
-        if (contract_it == context->contracts.end())
-            throw std::runtime_error("contract \"" + name_to_string(contract) + "\" is not loaded");
-        auto& c = contract_it->second;
+    return abieos_get_type_for_action_at(context, contract, latest_block, action);
+}
 
-        auto action_it = c.action_types.find(name{action});
-        if (action_it == c.action_types.end())
+extern "C" const char* abieos_get_type_for_action_at(abieos_context* context, uint64_t contract, uint32_t height,
+                                                     uint64_t action) {
+    return handle_exceptions(context, nullptr, [&] {
+        auto& c = get_contract(context->scratch, contract, height);
+        auto* type = find_action_type(c, name{action});
+        if (!type)
             throw std::runtime_error("contract \"" + name_to_string(contract) + "\" does not have action \"" +
                                      name_to_string(action) + "\"");
-        return action_it->second.c_str();
+        context->result_str.assign(type->begin(), type->end()); // the contract may be evicted
+        return context->result_str.c_str();
     });
 }
 
 extern "C" abieos_bool abieos_json_to_bin(abieos_context* context, uint64_t contract, const char* type,
                                           const char* json) {
+    return abieos_json_to_bin_at(context, contract, latest_block, type, json);
+}
+
+extern "C" abieos_bool abieos_json_to_bin_at(abieos_context* context, uint64_t contract, uint32_t height,
+                                             const char* type, const char* json) {
     fix_null_str(type);
     fix_null_str(json);
     return handle_exceptions(context, false, [&] {
-        context->last_error = "json parse error";
-        auto contract_it = context->contracts.find(::abieos::name{contract});
-        if (contract_it == context->contracts.end())
-            throw std::runtime_error("contract \"" + name_to_string(contract) + "\" is not loaded");
-        auto& t = get_type(contract_it->second.abi_types, type, 0);
-        context->result_bin.clear();
-        return json_to_bin(context->result_bin, &t, json);
+        return json_to_result_bin(context, get_type(context->scratch, contract, type, height), json);
     });
 }
 
 extern "C" const char* abieos_bin_to_json(abieos_context* context, uint64_t contract, const char* type,
                                           const char* data, size_t size) {
+    return abieos_bin_to_json_at(context, contract, latest_block, type, data, size);
+}
+
+extern "C" const char* abieos_bin_to_json_at(abieos_context* context, uint64_t contract, uint32_t height,
+                                             const char* type, const char* data, size_t size) {
     fix_null_str(type);
     return handle_exceptions(context, nullptr, [&]() -> const char* {
-        if (!data || !size)
-            throw std::runtime_error("no data");
-        context->last_error = "binary decode error";
-        auto contract_it = context->contracts.find(::abieos::name{contract});
-        if (contract_it == context->contracts.end())
-            throw std::runtime_error("contract \"" + name_to_string(contract) + "\" is not loaded");
-        auto& t = get_type(contract_it->second.abi_types, type, 0);
-        input_buffer bin{data, data + size};
-        if (!bin_to_json(bin, &t, context->result_str))
+        auto& t = get_type(context->scratch, contract, type, height);
+        if (!bin_to_json(context->scratch, t, data, size, context->result_str))
+            return nullptr;
+        return context->result_str.c_str();
+    });
+}
+
+extern "C" abieos_type_handle* abieos_get_type_handle(abieos_context* context, uint64_t contract, const char* type) {
+    fix_null_str(type);
+    return handle_exceptions(context, nullptr, [&] {
+        auto& [key, handle] = *context->type_handles.try_emplace(std::pair{name{contract}, hooked_string{type}}).first;
+        if (!handle.type || is_stale(context->scratch, handle)) {
+            handle.type = nullptr;
+            handle.contract = name{contract};
+            handle.type_name = key.second;
+            handle.abi = get_abi(context->scratch, contract);
+            handle.type = &get_type(get_contract(context->scratch, *handle.abi), type);
+            handle.serial = handle.abi->serial;
+        }
+        return &handle;
+    });
+}
+
+extern "C" abieos_bool abieos_json_to_bin_with_handle(abieos_context* context, const abieos_type_handle* handle,
+                                                      const char* json) {
+    fix_null_str(json);
+    return handle_exceptions(context, false,
+                             [&] { return json_to_result_bin(context, get_type(context, handle), json); });
+}
+
+extern "C" const char* abieos_bin_to_json_with_handle(abieos_context* context, const abieos_type_handle* handle,
+                                                      const char* data, size_t size) {
+    return handle_exceptions(context, nullptr, [&]() -> const char* {
+        if (!bin_to_json(context->scratch, get_type(context, handle), data, size, context->result_str))
             return nullptr;
-        if (bin.pos != bin.end)
-            throw std::runtime_error("Extra data");
         return context->result_str.c_str();
     });
 }
 
+extern "C" abieos_bool abieos_json_to_bin_into(abieos_context* context, uint64_t contract, const char* type,
+                                               const char* json, char* out, size_t cap, size_t* needed) {
+    fix_null_str(type);
+    fix_null_str(json);
+    return handle_exceptions(context, false, [&] {
+        if (!needed || (!out && cap))
+            throw std::runtime_error("no output buffer");
+        *needed = 0;
+        auto& t = get_type(context->scratch, contract, type);
+        if (!json_to_bin(context->scratch, t, json))
+            return false;
+        *needed = get_bin_size(context->scratch.json_to_bin);
+        if (*needed > cap) { // the usual way to learn the size, so it doesn't throw
+            set_error(context->scratch, "output buffer is too small");
+            return false;
+        }
+        write_bin(context->scratch.json_to_bin, out);
+        return true;
+    });
+}
+
+extern "C" abieos_bool abieos_bin_to_json_into(abieos_context* context, uint64_t contract, const char* type,
+                                               const char* data, size_t size, char* out, size_t cap, size_t* needed) {
+    fix_null_str(type);
+    return handle_exceptions(context, false, [&] {
+        if (!needed || (!out && cap))
+            throw std::runtime_error("no output buffer");
+        *needed = 0;
+        auto& t = get_type(context->scratch, contract, type);
+        output_stream stream{out, cap};
+        if (!bin_to_json(context->scratch, t, data, size, stream))
+            return false;
+        stream.Put(0);
+        *needed = stream.size();
+        if (stream.overflowed()) {
+            set_error(context->scratch, "output buffer is too small");
+            return false;
+        }
+        return true;
+    });
+}
+
 extern "C" const char* abieos_hex_to_json(abieos_context* context, uint64_t contract, const char* type,
                                           const char* hex) {
     fix_null_str(hex);
     return handle_exceptions(context, nullptr, [&]() -> const char* {
-        std::vector<char> data;
+        hooked_vector<char> data;
         boost::algorithm::unhex(hex, hex + strlen(hex), std::back_inserter(data));
         return abieos_bin_to_json(context, contract, type, data.data(), data.size());
     });
 }
+
+extern "C" const char* abieos_bin_to_json_batch(abieos_context* context, uint64_t contract, const char* type,
+                                                const char** datas, const size_t* sizes, size_t n, size_t* offsets,
+                                                abieos_bool* ok) {
+    fix_null_str(type);
+    return handle_exceptions(context, nullptr, [&]() -> const char* {
+        if (n && (!datas || !sizes || !offsets || !ok))
+            throw std::runtime_error("no data");
+        auto& t = get_type(context->scratch, contract, type);
+
+        reset_buffer(context->scratch, context->result_str);
+        output_stream stream{context->result_str};
+        for (size_t i = 0; i < n; ++i) {
+            offsets[i] = stream.size();
+            ok[i] = false;
+            try {
+                ok[i] = bin_to_json(context->scratch, t, datas[i], sizes[i], stream);
+            } catch (std::exception& e) {
+                set_error(context->scratch, e.what());
+            }
+            if (!ok[i]) {
+                stream.truncate(offsets[i]);
+                stream.write(context->scratch.last_error, strlen(context->scratch.last_error));
+            }
+            stream.Put(0);
+        }
+        stream.finish();
+        return context->result_str.c_str();
+    });
+}
+
+extern "C" const char* abieos_json_to_bin_batch(abieos_context* context, uint64_t contract, const char* type,
+                                                const char** jsons, size_t n, size_t* offsets, size_t* sizes,
+                                                abieos_bool* ok) {
+    fix_null_str(type);
+    return handle_exceptions(context, nullptr, [&]() -> const char* {
+        if (n && (!jsons || !offsets || !sizes || !ok))
+            throw std::runtime_error("no data");
+        auto& t = get_type(context->scratch, contract, type);
+
+        reset_buffer(context->scratch, context->result_bin);
+        for (size_t i = 0; i < n; ++i) {
+            offsets[i] = context->result_bin.size();
+            ok[i] = false;
+            try {
+                const char* json = jsons[i];
+                fix_null_str(json);
+                ok[i] = json_to_bin(context->scratch, context->result_bin, t, json);
+            } catch (std::exception& e) {
+                set_error(context->scratch, e.what());
+            }
+            if (!ok[i]) {
+                const char* error = context->scratch.last_error;
+                context->result_bin.resize(offsets[i]);
+                context->result_bin.insert(context->result_bin.end(), error, error + strlen(error));
+            }
+            sizes[i] = context->result_bin.size() - offsets[i];
+        }
+        return context->result_bin.empty() ? "" : context->result_bin.data(); // an empty vector's data may be null
+    });
+}
+
+extern "C" abieos_result* abieos_json_to_bin_result(abieos_context* context, uint64_t contract, const char* type,
+                                                    const char* json) {
+    fix_null_str(type);
+    fix_null_str(json);
+    return handle_exceptions(context, nullptr, [&] {
+        return json_to_bin_result(context, context->scratch, get_type(context->scratch, contract, type), json);
+    });
+}
+
+extern "C" abieos_result* abieos_bin_to_json_result(abieos_context* context, uint64_t contract, const char* type,
+                                                    const char* data, size_t size) {
+    fix_null_str(type);
+    return handle_exceptions(context, nullptr, [&] {
+        return bin_to_json_result(context, context->scratch, get_type(context->scratch, contract, type), data, size);
+    });
+}
+
+extern "C" abieos_result* abieos_json_to_bin_concurrent(abieos_context* context, uint64_t contract, const char* type,
+                                                        const char* json, abieos_result** error) {
+    fix_null_str(type);
+    fix_null_str(json);
+    return run_concurrent(context, error, [&](conversion_scratch& scratch) {
+        return json_to_bin_result(context, scratch, get_type(scratch, contract, type), json);
+    });
+}
+
+extern "C" abieos_result* abieos_bin_to_json_concurrent(abieos_context* context, uint64_t contract, const char* type,
+                                                        const char* data, size_t size, abieos_result** error) {
+    fix_null_str(type);
+    return run_concurrent(context, error, [&](conversion_scratch& scratch) {
+        return bin_to_json_result(context, scratch, get_type(scratch, contract, type), data, size);
+    });
+}
+
+extern "C" const char* abieos_result_data(const abieos_result* result) {
+    if (!result)
+        return nullptr;
+    return result->data.c_str();
+}
+
+extern "C" size_t abieos_result_size(const abieos_result* result) {
+    if (!result)
+        return 0;
+    return result->data.size();
+}
+
+extern "C" void abieos_result_retain(abieos_result* result) {
+    if (result)
+        result->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+extern "C" void abieos_result_release(abieos_result* result) {
+    if (result && result->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        result_slab::release(result->slab, result);
+}
@@ -8,11 +8,99 @@ extern "C" {
 #endif
 
 typedef struct abieos_context_s abieos_context;
+typedef struct abieos_type_handle_s abieos_type_handle;
+typedef struct abieos_result_s abieos_result;
+typedef struct abieos_registry_s abieos_registry;
 typedef int abieos_bool;
 
 // Create a context. The context holds all memory allocated by functions in this header. Returns null on failure.
 abieos_context* abieos_create();
 
+// Allocation hooks. alloc_fn returns memory aligned for any type, or null on failure. free_fn receives the size which
+// was passed to alloc_fn. Results may be released on other threads, so the hooks may be called from them.
+typedef void* (*abieos_alloc_fn)(void* user, size_t size);
+typedef void (*abieos_free_fn)(void* user, void* ptr, size_t size);
+
+// Create a context which allocates its memory through alloc_fn and free_fn. Pass null for both to use the global
+// allocator. Returns null on failure.
+abieos_context* abieos_create_with_allocator(abieos_alloc_fn alloc_fn, abieos_free_fn free_fn, void* user);
+
+// Create a registry: a set of compiled contracts which several contexts can share. Conversions read it without locking.
+// When an abi is replaced, conversions already running finish against the old contract and new ones see the new
+// contract. Returns null on failure.
+abieos_registry* abieos_registry_create();
+
+// Registries are reference counted. abieos_registry_create returns a count of 1; each context using the registry holds
+// another until it's destroyed.
+void abieos_registry_release(abieos_registry* registry);
+
+// Create a context which uses registry instead of a private one. abieos_set_abi* on any context sharing the registry
+// affects all of them. Returns null on failure.
+abieos_context* abieos_create_with_registry(abieos_registry* registry);
+
+// Get the registry a context uses. It stays valid while the context exists, or longer if it's passed to
+// abieos_create_with_registry. A context's private registry keeps allocating through the context's alloc_fn and
+// free_fn, so those and user must stay usable until the registry is released.
+abieos_registry* abieos_get_registry(abieos_context* context);
+
+// Limit the memory the registry's compiled contracts use. When compiling a contract pushes past the limit, the least
+// recently used contracts which no conversion is using are evicted; they're compiled again from their abi when next
+// needed. 0 (the default) means no limit. Returns false on error.
+abieos_bool abieos_registry_set_compiled_limit(abieos_registry* registry, size_t bytes);
+
+typedef struct abieos_registry_stats {
+    uint64_t compiled;       // contracts compiled now
+    uint64_t compiled_bytes; // memory they use
+    uint64_t compiles;       // total over the registry's lifetime, including recompiles
+    uint64_t recompiles;     // compiles of evicted contracts
+    uint64_t evictions;
+} abieos_registry_stats;
+
+// Get compilation and eviction counts. Returns false on error.
+abieos_bool abieos_registry_get_stats(abieos_registry* registry, abieos_registry_stats* stats);
+
+// Save the abis in the context's registry, with their heights and compiled contracts, to path. Abis which haven't been
+// compiled yet are compiled for the file. Returns false on error.
+abieos_bool abieos_save_registry(abieos_context* context, const char* path);
+
+// Load a file written by abieos_save_registry into the context's registry, replacing the abis of the contracts it
+// holds. The file is mapped rather than read, and conversions use its compiled contracts where they're mapped, so
+// they're never compiled, evicted or counted against the compiled limit; only contracts which a build with a different
+// layout saved are compiled again. Loading checks the contracts' structure, but doesn't parse the abis. The file must
+// not be modified while the registry uses it; abieos_save_registry replaces files rather than modifying them. Returns
+// false on error.
+abieos_bool abieos_load_registry(abieos_context* context, const char* path);
+
+// Shared registries let processes on one host use the same abis and compiled contracts through POSIX shared memory;
+// name is as for shm_open, e.g. "/abieos". Attached processes map a publication's contracts rather than compiling their
+// own, so compiled memory stays the same however many processes attach. Publish the abis in the context's registry, and
+// their contracts, under name, replacing its previous publication. Processes may publish concurrently; the publication
+// which started last wins. Returns false on error.
+abieos_bool abieos_publish_shared_registry(abieos_context* context, const char* name);
+
+// Attach the context's registry to a shared registry. Each later call on a context using the registry first loads any
+// newer publication, as abieos_load_registry would, except that it replaces all of the registry's contracts. A registry
+// can only be attached once. Returns false on error.
+abieos_bool abieos_attach_shared_registry(abieos_context* context, const char* name);
+
+// Remove a shared registry and its latest publication. Attached registries keep the abis they already loaded. Returns
+// false on error.
+abieos_bool abieos_unlink_shared_registry(abieos_context* context, const char* name);
+
+// Conversions reuse buffers owned by the context. Each buffer keeps its capacity between calls unless it grows past
+// this many bytes (default 256 KiB).
+void abieos_set_scratch_limit(abieos_context* context, size_t bytes);
+
+typedef struct abieos_alloc_stats {
+    uint64_t allocations;
+    uint64_t deallocations;
+    uint64_t bytes_allocated; // total over the context's lifetime
+    uint64_t bytes_in_use;
+} abieos_alloc_stats;
+
+// Get allocation counts for memory the context routes through its allocator. Returns false on error.
+abieos_bool abieos_get_alloc_stats(abieos_context* context, abieos_alloc_stats* stats);
+
 // Destroy a context.
 void abieos_destroy(abieos_context* context);
 
@@ -33,16 +121,42 @@ const char* abieos_get_bin_hex(abieos_context* context);
 uint64_t abieos_string_to_name(abieos_context* context, const char* str);
 const char* abieos_name_to_string(abieos_context* context, uint64_t name);
 
-// Set abi (JSON format). Returns false on error.
+// Set abi (JSON format). Replaces the contract's existing abis, if any. Returns false on error. The abi is checked here
+// but compiled on first use, so some errors (e.g. type cycles) surface from the first conversion. Contracts in a
+// registry which are set from identical bytes share one abi; setting a contract's current abi again leaves its type
+// handles valid.
 abieos_bool abieos_set_abi(abieos_context* context, uint64_t contract, const char* abi);
 
-// Set abi (binary format). Returns false on error.
+// Set abi (binary format). Replaces the contract's existing abis, if any. Returns false on error.
 abieos_bool abieos_set_abi_bin(abieos_context* context, uint64_t contract, const char* data, size_t size);
 
-// Set abi (hex format). Returns false on error.
+// Set abi (hex format). Replaces the contract's existing abis, if any. Returns false on error.
 abieos_bool abieos_set_abi_hex(abieos_context* context, uint64_t contract, const char* hex);
 
-// Get the type name for an action. The contract owns the returned memory. Returns null on error; use abieos_get_error
+// One contract's abi (binary format), for abieos_set_abis_bin
+typedef struct abieos_abi_bin {
+    uint64_t contract;
+    const char* data;
+    size_t size;
+} abieos_abi_bin;
+
+// Set the abis of many contracts, as abieos_set_abi_bin would one at a time, but parse and check them, and if compile
+// is set compile them, on up to threads threads (0 for one per core). The abis which succeed are published together,
+// so conversions see either none or all of them; contracts whose abi failed keep their previous abis. If errors isn't
+// null, errors[i] receives null if abis[i] succeeded, or its error message, which the context owns until the next call
+// to this function. Returns false if any abi failed.
+abieos_bool abieos_set_abis_bin(abieos_context* context, const abieos_abi_bin* abis, size_t count, unsigned threads,
+                                abieos_bool compile, const char** errors);
+
+// Add a version of the contract's abi which is in force from block height until the next version's, replacing any
+// version at the same height. Functions which take a height use the version in force at it; the others, and type
+// handles, use the latest version. Returns false on error.
+abieos_bool abieos_set_abi_at(abieos_context* context, uint64_t contract, uint32_t height, const char* abi);
+abieos_bool abieos_set_abi_bin_at(abieos_context* context, uint64_t contract, uint32_t height, const char* data,
+                                  size_t size);
+abieos_bool abieos_set_abi_hex_at(abieos_context* context, uint64_t contract, uint32_t height, const char* hex);
+
+// Get the type name for an action. The context owns the returned string. Returns null on error; use abieos_get_error
 // to retrieve error.
 const char* abieos_get_type_for_action(abieos_context* context, uint64_t contract, uint64_t action);
 
@@ -54,10 +168,88 @@ abieos_bool abieos_json_to_bin(abieos_context* context, uint64_t contract, const
 const char* abieos_bin_to_json(abieos_context* context, uint64_t contract, const char* type, const char* data,
                                size_t size);
 
+// Same as above, using the abi version in force at block height. Fail if the contract had no abi then.
+const char* abieos_get_type_for_action_at(abieos_context* context, uint64_t contract, uint32_t height,
+                                          uint64_t action);
+abieos_bool abieos_json_to_bin_at(abieos_context* context, uint64_t contract, uint32_t height, const char* type,
+                                  const char* json);
+const char* abieos_bin_to_json_at(abieos_context* context, uint64_t contract, uint32_t height, const char* type,
+                                  const char* data, size_t size);
+
+// Resolve a type once so repeated conversions skip the contract and type lookups. The context owns the returned handle;
+// calling this again with the same arguments returns the same handle. Replacing the contract's abi makes the handle
+// stale: conversions using it fail until it's refreshed by calling this again. Returns null on error; use
+// abieos_get_error to retrieve error.
+abieos_type_handle* abieos_get_type_handle(abieos_context* context, uint64_t contract, const char* type);
+
+// Convert json to binary using a type handle from the same context. Use abieos_get_bin_* to retrieve result. Returns
+// false on error.
+abieos_bool abieos_json_to_bin_with_handle(abieos_context* context, const abieos_type_handle* handle, const char* json);
+
+// Convert binary to json using a type handle from the same context. The context owns the returned string. Returns null
+// on error; use abieos_get_error to retrieve error.
+const char* abieos_bin_to_json_with_handle(abieos_context* context, const abieos_type_handle* handle, const char* data,
+                                           size_t size);
+
+// Convert json to binary, writing the result directly to out. *needed receives the result's size; if it exceeds cap,
+// out is left unspecified and this returns false. Returns false on error; use abieos_get_error to retrieve error.
+abieos_bool abieos_json_to_bin_into(abieos_context* context, uint64_t contract, const char* type, const char* json,
+                                    char* out, size_t cap, size_t* needed);
+
+// Convert binary to json, writing a null-terminated string directly to out. *needed receives the string's size,
+// including the terminator; if it exceeds cap, out is left unspecified and this returns false. Returns false on error;
+// use abieos_get_error to retrieve error.
+abieos_bool abieos_bin_to_json_into(abieos_context* context, uint64_t contract, const char* type, const char* data,
+                                    size_t size, char* out, size_t cap, size_t* needed);
+
 // Convert hex to json. The context owns the returned memory. Returns null on error; use abieos_get_error to retrieve
 // error.
 const char* abieos_hex_to_json(abieos_context* context, uint64_t contract, const char* type, const char* hex);
 
+// Convert n binaries of the same type to json. The type is resolved once for the whole batch. Returns a buffer holding
+// n null-terminated strings; offsets[i] receives the position of string i within it. ok[i] receives false if item i
+// failed to convert; its string then holds the error message. The context owns the returned buffer. Returns null if the
+// batch as a whole fails (e.g. the type doesn't exist); use abieos_get_error to retrieve error.
+const char* abieos_bin_to_json_batch(abieos_context* context, uint64_t contract, const char* type, const char** datas,
+                                     const size_t* sizes, size_t n, size_t* offsets, abieos_bool* ok);
+
+// Convert n json documents of the same type to binary. The type is resolved once for the whole batch. Returns a buffer
+// holding the results back to back; offsets[i] and sizes[i] receive the position and size of result i within it. ok[i]
+// receives false if item i failed to convert; its result then holds the error message (not null-terminated). The
+// context owns the returned buffer; abieos_get_bin_* also refer to it. Returns null if the batch as a whole fails
+// (e.g. the type doesn't exist); use abieos_get_error to retrieve error.
+const char* abieos_json_to_bin_batch(abieos_context* context, uint64_t contract, const char* type, const char** jsons,
+                                     size_t n, size_t* offsets, size_t* sizes, abieos_bool* ok);
+
+// Convert json to binary. Unlike abieos_json_to_bin, the result isn't overwritten by later calls; it stays alive until
+// released, even past abieos_destroy. Returns null on error; use abieos_get_error to retrieve error.
+abieos_result* abieos_json_to_bin_result(abieos_context* context, uint64_t contract, const char* type,
+                                         const char* json);
+
+// Convert binary to json. Unlike abieos_bin_to_json, the result isn't overwritten by later calls; it stays alive until
+// released, even past abieos_destroy. Returns null on error; use abieos_get_error to retrieve error.
+abieos_result* abieos_bin_to_json_result(abieos_context* context, uint64_t contract, const char* type,
+                                         const char* data, size_t size);
+
+// Thread-safe conversions. Unlike the other functions in this header, these may be called from several threads at once
+// on the same context, and concurrently with abieos_set_abi* on any context sharing its registry. Other functions
+// still require that only one thread use the context at a time. Each call borrows scratch buffers from a pool inside
+// the context, so threads don't need contexts of their own. Returns null on error; if error isn't null, *error then
+// receives a result holding the message, which the caller must release.
+abieos_result* abieos_json_to_bin_concurrent(abieos_context* context, uint64_t contract, const char* type,
+                                             const char* json, abieos_result** error);
+abieos_result* abieos_bin_to_json_concurrent(abieos_context* context, uint64_t contract, const char* type,
+                                             const char* data, size_t size, abieos_result** error);
+
+// Access a result. Json results are null-terminated; the size doesn't include the terminator.
+const char* abieos_result_data(const abieos_result* result);
+size_t abieos_result_size(const abieos_result* result);
+
+// Results are reference counted; conversions return them with a count of 1. Retain and release may be called from
+// any thread. Released results are recycled by the context which created them.
+void abieos_result_retain(abieos_result* result);
+void abieos_result_release(abieos_result* result);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,8 +1,13 @@
 // copyright defined in abieos/LICENSE.txt
 
+#include <algorithm>
+#include <atomic>
 #include <boost/algorithm/hex.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <cerrno>
+#include <charconv>
 #include <ctime>
+#include <limits>
 #include <map>
 #include <vector>
 
@@ -23,6 +28,192 @@ inline constexpr bool trace_bin_to_json = false;
 
 inline constexpr size_t max_stack_size = 128;
 
+///////////////////////////////////////////////////////////////////////////////
+// allocation
+///////////////////////////////////////////////////////////////////////////////
+
+// Routes a context's allocations to caller-provided functions and counts them. Uses global new if alloc_fn is null.
+struct allocator_hooks {
+    void* (*alloc_fn)(void* user, size_t size) = nullptr;
+    void (*free_fn)(void* user, void* p, size_t size) = nullptr;
+    void* user = nullptr;
+
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> deallocations{0};
+    std::atomic<uint64_t> bytes_allocated{0};
+    std::atomic<uint64_t> bytes_in_use{0};
+
+    void* allocate(size_t size) {
+        void* p = alloc_fn ? alloc_fn(user, size) : ::operator new(size);
+        if (!p)
+            throw std::bad_alloc{};
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        bytes_allocated.fetch_add(size, std::memory_order_relaxed);
+        bytes_in_use.fetch_add(size, std::memory_order_relaxed);
+        return p;
+    }
+
+    void deallocate(void* p, size_t size) noexcept {
+        deallocations.fetch_add(1, std::memory_order_relaxed);
+        bytes_in_use.fetch_sub(size, std::memory_order_relaxed);
+        if (free_fn)
+            free_fn(user, p, size);
+        else
+            ::operator delete(p);
+    }
+};
+
+// Containers which use context_allocator bind to these hooks when they're constructed. The C API sets them for the
+// duration of each call.
+inline thread_local allocator_hooks* current_allocator_hooks = nullptr;
+
+struct allocator_scope {
+    allocator_hooks* prev = current_allocator_hooks;
+
+    explicit allocator_scope(allocator_hooks* hooks) { current_allocator_hooks = hooks; }
+    allocator_scope(const allocator_scope&) = delete;
+    ~allocator_scope() { current_allocator_hooks = prev; }
+};
+
+template <typename T>
+struct context_allocator {
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    allocator_hooks* hooks = current_allocator_hooks;
+
+    context_allocator() = default;
+
+    template <typename U>
+    context_allocator(const context_allocator<U>& other) : hooks{other.hooks} {}
+
+    T* allocate(size_t n) {
+        if (hooks)
+            return static_cast<T*>(hooks->allocate(n * sizeof(T)));
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        if (hooks)
+            hooks->deallocate(p, n * sizeof(T));
+        else
+            ::operator delete(p);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const context_allocator<T>& a, const context_allocator<U>& b) {
+    return a.hooks == b.hooks;
+}
+
+template <typename T, typename U>
+bool operator!=(const context_allocator<T>& a, const context_allocator<U>& b) {
+    return a.hooks != b.hooks;
+}
+
+struct string_less {
+    using is_transparent = void;
+    bool operator()(std::string_view a, std::string_view b) const { return a < b; }
+};
+
+using hooked_string = std::basic_string<char, std::char_traits<char>, context_allocator<char>>;
+
+template <typename T>
+using hooked_vector = std::vector<T, context_allocator<T>>;
+
+template <typename K, typename V, typename Compare = std::less<K>>
+using hooked_map = std::map<K, V, Compare, context_allocator<std::pair<const K, V>>>;
+
+// Monotonic memory for temporaries which die before a C API call returns. allocate() bumps a pointer, deallocation is
+// a no-op, and reset() frees everything at once. reset() is constant time unless the blocks overflowed since the last
+// reset; then it merges them into one block, so the same workload fits in a single block next time.
+struct scratch_arena {
+    static constexpr size_t min_block_size = 4096;
+
+    hooked_vector<hooked_vector<char>> blocks{};
+    size_t used = 0; // bytes used in blocks.back()
+
+    void* allocate(size_t size) {
+        size = (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+        if (blocks.empty() || blocks.back().size() - used < size) {
+            blocks.emplace_back(std::max(size, blocks.empty() ? min_block_size : blocks.back().size() * 2));
+            used = 0;
+        }
+        auto* p = blocks.back().data() + used;
+        used += size;
+        return p;
+    }
+
+    void reset() {
+        if (blocks.size() > 1) {
+            size_t total = 0;
+            for (auto& block : blocks)
+                total += block.size();
+            blocks.clear();
+            blocks.emplace_back(total);
+        }
+        used = 0;
+    }
+
+    size_t capacity() const { return blocks.empty() ? 0 : blocks.back().size(); }
+};
+
+// Containers which use arena_allocator bind to this arena when they're constructed. The C API sets it for the duration
+// of each call and resets the arena afterwards. Without an arena, arena_allocator uses global new.
+inline thread_local scratch_arena* current_scratch_arena = nullptr;
+
+struct scratch_arena_scope {
+    scratch_arena* arena;
+    scratch_arena* prev = current_scratch_arena;
+
+    explicit scratch_arena_scope(scratch_arena* arena) : arena{arena} { current_scratch_arena = arena; }
+    scratch_arena_scope(const scratch_arena_scope&) = delete;
+    ~scratch_arena_scope() {
+        current_scratch_arena = prev;
+        arena->reset();
+    }
+};
+
+template <typename T>
+struct arena_allocator {
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    scratch_arena* arena = current_scratch_arena;
+
+    arena_allocator() = default;
+
+    template <typename U>
+    arena_allocator(const arena_allocator<U>& other) : arena{other.arena} {}
+
+    T* allocate(size_t n) {
+        if (arena)
+            return static_cast<T*>(arena->allocate(n * sizeof(T)));
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t) noexcept {
+        if (!arena)
+            ::operator delete(p);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const arena_allocator<T>& a, const arena_allocator<U>& b) {
+    return a.arena == b.arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const arena_allocator<T>& a, const arena_allocator<U>& b) {
+    return a.arena != b.arena;
+}
+
+using arena_string = std::basic_string<char, std::char_traits<char>, arena_allocator<char>>;
+
 template <typename T>
 inline constexpr bool is_vector_v = false;
 
@@ -48,13 +239,8 @@ auto& member_from_void(member_ptr<P>, void* p) {
     return class_from_void(P, p)->*P;
 }
 
-// Pseudo objects never exist, except in serialized form
-struct pseudo_optional;
-struct pseudo_object;
-struct pseudo_array;
-
 template <typename T>
-void push_raw(std::vector<char>& bin, const T& obj) {
+void push_raw(hooked_vector<char>& bin, const T& obj) {
     static_assert(std::is_trivially_copyable_v<T>);
     bin.insert(bin.end(), reinterpret_cast<const char*>(&obj), reinterpret_cast<const char*>(&obj + 1));
 }
@@ -86,14 +272,77 @@ T read_bin(input_buffer& bin) {
 
 uint32_t read_varuint32(input_buffer& bin);
 
-inline std::string read_string(input_buffer& bin) {
-    auto size = read_varuint32(bin);
-    if (size > bin.end - bin.pos)
-        throw std::runtime_error("invalid string size");
-    std::string result(size, 0);
-    read_bin(bin, result.data(), size);
-    return result;
-}
+// rapidjson output stream. Writes either to a growable string or to caller-owned memory. Caller-owned memory is never
+// overrun; once it's full the stream keeps counting, so the caller can learn the required size.
+struct output_stream {
+    using Ch = char;
+
+    hooked_string* growable = nullptr;
+    char* begin = nullptr;
+    char* pos = nullptr;
+    char* end = nullptr;
+    size_t overflow = 0;
+
+    output_stream() = default;
+    output_stream(const output_stream&) = delete;
+
+    // Appends to dest. Call finish() to trim dest to the written size. dest grows as it's written, so its spare
+    // capacity isn't cleared on every call.
+    explicit output_stream(hooked_string& dest) : growable{&dest} {
+        begin = dest.data();
+        pos = begin + dest.size();
+        end = pos;
+    }
+
+    output_stream(char* dest, size_t capacity) : begin{dest}, pos{dest}, end{dest + capacity} {}
+
+    size_t size() const { return pos - begin + overflow; }
+    bool overflowed() const { return overflow; }
+
+    void Put(char c) {
+        if (pos != end)
+            *pos++ = c;
+        else
+            put_slow(c);
+    }
+
+    void Flush() {}
+
+    void write(const char* data, size_t size) {
+        while (size--)
+            Put(*data++);
+    }
+
+    // Discards everything written after the first size bytes
+    void truncate(size_t size) {
+        if (size <= size_t(pos - begin)) {
+            pos = begin + size;
+            overflow = 0;
+        } else
+            overflow = size - (pos - begin);
+    }
+
+    void finish() {
+        if (growable)
+            growable->resize(pos - begin);
+    }
+
+  private:
+    void put_slow(char c) {
+        if (!growable) {
+            ++overflow;
+            return;
+        }
+        auto size = pos - begin;
+        growable->resize(std::max<size_t>(256, size * 2));
+        begin = growable->data();
+        pos = begin + size;
+        end = begin + growable->size();
+        *pos++ = c;
+    }
+};
+
+using json_writer = rapidjson::Writer<output_stream>;
 
 ///////////////////////////////////////////////////////////////////////////////
 // stream events
@@ -115,8 +364,8 @@ struct event_data {
     uint64_t value_uint64 = 0;
     int64_t value_int64 = 0;
     double value_double = 0;
-    std::string value_string{};
-    std::string key{};
+    hooked_string value_string{};
+    hooked_string key{};
 };
 
 bool receive_event(struct json_to_native_state&, event_type, bool start);
@@ -126,6 +375,7 @@ template <typename Derived>
 struct json_reader_handler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, Derived> {
     event_data received_data{};
     bool started = false;
+    hooked_string error{};
 
     Derived& get_derived() { return *static_cast<Derived*>(this); }
 
@@ -148,12 +398,12 @@ struct json_reader_handler : public rapidjson::BaseReaderHandler<rapidjson::UTF8
     bool Uint64(uint64_t v) { return false; }
     bool Double(double v) { return false; }
     bool String(const char* v, rapidjson::SizeType length, bool) {
-        received_data.value_string = {v, length};
+        received_data.value_string.assign(v, length);
         return receive_event(get_derived(), event_type::received_string, get_start());
     }
     bool StartObject() { return receive_event(get_derived(), event_type::received_start_object, get_start()); }
     bool Key(const char* v, rapidjson::SizeType length, bool) {
-        received_data.key = {v, length};
+        received_data.key.assign(v, length);
         return receive_event(get_derived(), event_type::received_key, get_start());
     }
     bool EndObject(rapidjson::SizeType) {
@@ -183,40 +433,53 @@ struct native_stack_entry {
     int array_size = 0;
 };
 
+// A struct or array which a plan entered, and where to continue once it's converted
 struct json_to_bin_stack_entry {
     const struct abi_type* type = nullptr;
     int position = -1;
     size_t size_insertion_index = 0;
+    const struct plan_op* caller = nullptr;
 };
 
 struct bin_to_json_stack_entry {
-    const struct abi_type* type = nullptr;
-    int position = -1;
-    uint32_t array_size = 0;
+    const struct plan_op* caller = nullptr;
+    uint32_t remaining_items = 0;
 };
 
 struct json_to_native_state : json_reader_handler<json_to_native_state> {
-    std::vector<native_stack_entry> stack;
+    hooked_vector<native_stack_entry> stack;
 };
 
 struct bin_to_native_state {
     input_buffer bin{};
-    std::vector<native_stack_entry> stack{};
+    hooked_vector<native_stack_entry> stack{};
 };
 
 struct json_to_bin_state : json_reader_handler<json_to_bin_state> {
-    std::vector<char> bin;
-    std::vector<size_insertion> size_insertions{};
-    std::vector<json_to_bin_stack_entry> stack{};
+    rapidjson::Reader reader{};
+    hooked_vector<char> bin;
+    hooked_vector<size_insertion> size_insertions{};
+    hooked_vector<json_to_bin_stack_entry> stack{};
+    const struct plan_op* op = nullptr; // expects the next event
+    std::string_view received_string{}; // a string, number or key; into the reader's buffer, which ends it with a 0
+
+    // Keys are compared, and most strings converted, in place; received_data.value_string is only filled for the
+    // serializers which need it
+    bool RawNumber(const char* v, rapidjson::SizeType length, bool copy) { return String(v, length, copy); }
+    bool String(const char* v, rapidjson::SizeType length, bool) {
+        received_string = {v, length};
+        return receive_event(*this, event_type::received_string, get_start());
+    }
+    bool Key(const char* v, rapidjson::SizeType length, bool) {
+        received_string = {v, length};
+        return receive_event(*this, event_type::received_key, get_start());
+    }
 };
 
 struct bin_to_json_state : json_reader_handler<bin_to_json_state> {
-    input_buffer& bin;
-    rapidjson::Writer<rapidjson::StringBuffer>& writer;
-    std::vector<bin_to_json_stack_entry> stack{};
-
-    bin_to_json_state(input_buffer& bin, rapidjson::Writer<rapidjson::StringBuffer>& writer)
-        : bin{bin}, writer{writer} {}
+    input_buffer bin{};
+    json_writer writer{};
+    hooked_vector<bin_to_json_stack_entry> stack{};
 };
 
 struct native_serializer {
@@ -234,10 +497,43 @@ struct native_field_serializer {
     const native_field_serializer_methods* methods = nullptr;
 };
 
-struct abi_serializer {
-    virtual bool json_to_bin(json_to_bin_state&, const abi_type*, event_type, bool) const = 0;
-    virtual bool bin_to_json(bin_to_json_state&, const abi_type*, bool) const = 0;
-};
+using json_to_bin_fn = bool(json_to_bin_state&, event_type);
+using bin_to_json_fn = bool(bin_to_json_state&);
+
+
+// Serializers report malformed input by storing a message in state.error and returning false. Spam and untrusted input
+// fail often enough that unwinding would dominate; exceptions are reserved for conditions that aren't the input's
+// fault.
+template <typename State, typename... Ts>
+bool report_error(State& state, const Ts&... parts) {
+    state.error.clear();
+    (state.error.append(std::string_view{parts}), ...);
+    return false;
+}
+
+template <typename T>
+bool read_bin(bin_to_json_state& state, T& dest) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    if (state.bin.end - state.bin.pos < (ptrdiff_t)sizeof(dest))
+        return report_error(state, "read past end");
+    memcpy(&dest, state.bin.pos, sizeof(dest));
+    state.bin.pos += sizeof(dest);
+    return true;
+}
+
+bool read_varuint32(bin_to_json_state& state, uint32_t& dest);
+
+// The result points into state.bin
+inline bool read_string(bin_to_json_state& state, std::string_view& dest, const char* size_error) {
+    uint32_t size;
+    if (!read_varuint32(state, size))
+        return false;
+    if (size > state.bin.end - state.bin.pos)
+        return report_error(state, size_error);
+    dest = {state.bin.pos, size};
+    state.bin.pos += size;
+    return true;
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 // serializer function prototypes
@@ -269,59 +565,74 @@ template <typename T>
 auto json_to_bin(T*, json_to_bin_state& state, const abi_type*, event_type event, bool start)
     -> std::enable_if_t<std::is_arithmetic_v<T>, bool>;
 bool json_to_bin(std::string*, json_to_bin_state& state, const abi_type*, event_type event, bool start);
-bool json_to_bin(pseudo_optional*, json_to_bin_state& state, const abi_type* type, event_type event, bool start);
-bool json_to_bin(pseudo_object*, json_to_bin_state& state, const abi_type* type, event_type event, bool start);
-bool json_to_bin(pseudo_array*, json_to_bin_state& state, const abi_type* type, event_type event, bool start);
 
 template <typename T>
 auto bin_to_json(T*, bin_to_json_state& state, const abi_type*, bool start)
     -> std::enable_if_t<std::is_arithmetic_v<T>, bool>;
 bool bin_to_json(std::string*, bin_to_json_state& state, const abi_type*, bool start);
-bool bin_to_json(pseudo_optional*, bin_to_json_state& state, const abi_type* type, bool start);
-bool bin_to_json(pseudo_object*, bin_to_json_state& state, const abi_type* type, bool start);
-bool bin_to_json(pseudo_array*, bin_to_json_state& state, const abi_type* type, bool start);
 
 ///////////////////////////////////////////////////////////////////////////////
 // serializable types
 ///////////////////////////////////////////////////////////////////////////////
 
 template <typename T, typename State>
-T json_to_number(State& state, event_type event) {
-    if (event == event_type::received_bool)
-        return state.received_data.value_bool;
+bool json_to_number(T& dest, State& state, event_type event) {
+    if (event == event_type::received_bool) {
+        dest = state.received_data.value_bool;
+        return true;
+    }
     if (event == event_type::received_string) {
-        auto check = [](auto f) {
-            using T2 = decltype(f());
-            T2 result;
-            try {
-                result = f();
-            } catch (...) {
-                throw std::runtime_error("number is out of range or has bad format");
-            }
-            if ((T2)(T)result != result)
-                throw std::runtime_error("number is out of range");
-            return result;
-        };
         auto& s = state.received_data.value_string;
-        if (std::is_integral_v<T> && std::is_signed_v<T>)
-            return check([&] { return stoll(s); });
-        else if (std::is_integral_v<T> && !std::is_signed_v<T>) {
+        char* end = nullptr;
+        errno = 0;
+        auto check = [&](auto result) {
+            if (end == s.c_str() || errno == ERANGE)
+                return report_error(state, "number is out of range or has bad format");
+            if (std::is_integral_v<T> && (decltype(result))(T)result != result)
+                return report_error(state, "number is out of range");
+            dest = result;
+            return true;
+        };
+        if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+            return check(strtoll(s.c_str(), &end, 10));
+        else if constexpr (std::is_integral_v<T> && !std::is_signed_v<T>) {
             if (s.find('-') != s.npos)
-                throw std::runtime_error("expected non-negative number");
-            return check([&] { return stoull(s); });
-        } else if (std::is_same_v<T, float>)
-            return stof(s);
-        else if (std::is_same_v<T, double>)
-            return stod(s);
-    }
-    throw std::runtime_error("expected number or boolean");
-} // namespace abieos
+                return report_error(state, "expected non-negative number");
+            return check(strtoull(s.c_str(), &end, 10));
+        } else if constexpr (std::is_same_v<T, float>)
+            return check(strtof(s.c_str(), &end));
+        else if constexpr (std::is_same_v<T, double>)
+            return check(strtod(s.c_str(), &end));
+    }
+    return report_error(state, "expected number or boolean");
+}
+
+// Returns the number of bytes written to dest, or -1 if src contains a non-hex digit. src.size() must be even.
+template <typename OutputIt>
+ptrdiff_t unhex(std::string_view src, OutputIt dest) {
+    auto digit = [](char c) {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    };
+    for (size_t i = 0; i < src.size(); i += 2) {
+        int hi = digit(src[i]), lo = digit(src[i + 1]);
+        if (hi < 0 || lo < 0)
+            return -1;
+        *dest++ = char((hi << 4) | lo);
+    }
+    return src.size() / 2;
+}
 
 struct bytes {
     std::vector<char> data;
 };
 
-void push_varuint32(std::vector<char>& bin, uint32_t v);
+void push_varuint32(hooked_vector<char>& bin, uint32_t v);
 
 inline bool json_to_bin(bytes*, json_to_bin_state& state, const abi_type*, event_type event, bool start) {
     if (event == event_type::received_string) {
@@ -329,26 +640,22 @@ inline bool json_to_bin(bytes*, json_to_bin_state& state, const abi_type*, event
         if (trace_json_to_bin)
             printf("%*sbytes (%d hex digits)\n", int(state.stack.size() * 4), "", int(s.size()));
         if (s.size() & 1)
-            throw std::runtime_error("odd number of hex digits");
+            return report_error(state, "odd number of hex digits");
         push_varuint32(state.bin, s.size() / 2);
-        try {
-            boost::algorithm::unhex(s.begin(), s.end(), std::back_inserter(state.bin));
-        } catch (...) {
-            throw std::runtime_error("expected hex string");
-        }
+        if (unhex(s, std::back_inserter(state.bin)) < 0)
+            return report_error(state, "expected hex string");
         return true;
     } else
-        throw std::runtime_error("expected string containing hex digits");
+        return report_error(state, "expected string containing hex digits");
 }
 
 inline bool bin_to_json(bytes*, bin_to_json_state& state, const abi_type*, bool start) {
-    auto size = read_varuint32(state.bin);
-    if (size > state.bin.end - state.bin.pos)
-        throw std::runtime_error("invalid bytes size");
-    std::vector<char> raw(size);
-    read_bin(state.bin, raw.data(), size);
-    std::string result;
-    boost::algorithm::hex(raw.begin(), raw.end(), std::back_inserter(result));
+    std::string_view data;
+    if (!read_string(state, data, "invalid bytes size"))
+        return false;
+    arena_string result;
+    result.reserve(data.size() * 2);
+    boost::algorithm::hex(data.begin(), data.end(), std::back_inserter(result));
     return state.writer.String(result.c_str(), result.size());
 }
 
@@ -368,26 +675,25 @@ inline bool json_to_bin(fixed_binary<size>*, json_to_bin_state& state, const abi
         auto& s = state.received_data.value_string;
         if (trace_json_to_bin)
             printf("%*schecksum\n", int(state.stack.size() * 4), "");
-        std::vector<uint8_t> v;
-        try {
-            boost::algorithm::unhex(s.begin(), s.end(), std::back_inserter(v));
-        } catch (...) {
-            throw std::runtime_error("expected hex string");
-        }
-        if (v.size() != size)
-            throw std::runtime_error("hex string has incorrect length");
+        if (s.size() != size * 2)
+            return report_error(state, "hex string has incorrect length");
+        std::array<uint8_t, size> v;
+        if (unhex(s, v.begin()) < 0)
+            return report_error(state, "expected hex string");
         state.bin.insert(state.bin.end(), v.begin(), v.end());
         return true;
     } else
-        throw std::runtime_error("expected string containing hex");
+        return report_error(state, "expected string containing hex");
 }
 
 template <unsigned size>
 inline bool bin_to_json(fixed_binary<size>*, bin_to_json_state& state, const abi_type*, bool start) {
-    auto v = read_bin<fixed_binary<size>>(state.bin);
-    std::string result;
-    boost::algorithm::hex(v.value.begin(), v.value.end(), std::back_inserter(result));
-    return state.writer.String(result.c_str(), result.size());
+    fixed_binary<size> v;
+    if (!read_bin(state, v))
+        return false;
+    char result[size * 2];
+    boost::algorithm::hex(v.value.begin(), v.value.end(), result);
+    return state.writer.String(result, size * 2);
 }
 
 struct uint128 {
@@ -399,16 +705,20 @@ inline bool json_to_bin(uint128*, json_to_bin_state& state, const abi_type*, eve
         auto& s = state.received_data.value_string;
         if (trace_json_to_bin)
             printf("%*suint128\n", int(state.stack.size() * 4), "");
-        auto value = decimal_to_binary<16>(s);
+        std::array<uint8_t, 16> value;
+        if (auto* error = decimal_to_binary(value, s))
+            return report_error(state, error);
         push_raw(state.bin, value);
         return true;
     } else
-        throw std::runtime_error("expected string containing uint128");
+        return report_error(state, "expected string containing uint128");
 }
 
 inline bool bin_to_json(uint128*, bin_to_json_state& state, const abi_type*, bool start) {
-    auto v = read_bin<uint128>(state.bin);
-    auto result = binary_to_decimal(v.value);
+    uint128 v;
+    if (!read_bin(state, v))
+        return false;
+    auto result = binary_to_decimal<arena_string>(v.value);
     return state.writer.String(result.c_str(), result.size());
 }
 
@@ -426,25 +736,29 @@ inline bool json_to_bin(int128*, json_to_bin_state& state, const abi_type*, even
             negative = true;
             s = s.substr(1);
         }
-        auto value = decimal_to_binary<16>(s);
+        std::array<uint8_t, 16> value;
+        if (auto* error = decimal_to_binary(value, s))
+            return report_error(state, error);
         if (negative)
             negate(value);
         if (is_negative(value) != negative)
-            throw std::runtime_error("number is out of range");
+            return report_error(state, "number is out of range");
         push_raw(state.bin, value);
         return true;
     } else
-        throw std::runtime_error("expected string containing int128");
+        return report_error(state, "expected string containing int128");
 }
 
 inline bool bin_to_json(int128*, bin_to_json_state& state, const abi_type*, bool start) {
-    auto v = read_bin<int128>(state.bin);
+    int128 v;
+    if (!read_bin(state, v))
+        return false;
     bool negative = is_negative(v.value);
     if (negative)
         negate(v.value);
-    auto result = binary_to_decimal(v.value);
+    auto result = binary_to_decimal<arena_string>(v.value);
     if (negative)
-        result = "-" + result;
+        result.insert(result.begin(), '-');
     return state.writer.String(result.c_str(), result.size());
 }
 
@@ -457,11 +771,13 @@ inline bool json_to_bin(public_key*, json_to_bin_state& state, const abi_type*,
         push_raw(state.bin, key);
         return true;
     } else
-        throw std::runtime_error("expected string containing public_key");
+        return report_error(state, "expected string containing public_key");
 }
 
 inline bool bin_to_json(public_key*, bin_to_json_state& state, const abi_type*, bool start) {
-    auto v = read_bin<public_key>(state.bin);
+    public_key v;
+    if (!read_bin(state, v))
+        return false;
     auto result = public_key_to_string(v);
     return state.writer.String(result.c_str(), result.size());
 }
@@ -475,11 +791,13 @@ inline bool json_to_bin(private_key*, json_to_bin_state& state, const abi_type*,
         push_raw(state.bin, key);
         return true;
     } else
-        throw std::runtime_error("expected string containing private_key");
+        return report_error(state, "expected string containing private_key");
 }
 
 inline bool bin_to_json(private_key*, bin_to_json_state& state, const abi_type*, bool start) {
-    auto v = read_bin<private_key>(state.bin);
+    private_key v;
+    if (!read_bin(state, v))
+        return false;
     auto result = private_key_to_string(v);
     return state.writer.String(result.c_str(), result.size());
 }
@@ -493,11 +811,13 @@ inline bool json_to_bin(signature*, json_to_bin_state& state, const abi_type*, e
         push_raw(state.bin, key);
         return true;
     } else
-        throw std::runtime_error("expected string containing signature");
+        return report_error(state, "expected string containing signature");
 }
 
 inline bool bin_to_json(signature*, bin_to_json_state& state, const abi_type*, bool start) {
-    auto v = read_bin<signature>(state.bin);
+    signature v;
+    if (!read_bin(state, v))
+        return false;
     auto result = signature_to_string(v);
     return state.writer.String(result.c_str(), result.size());
 }
@@ -520,22 +840,24 @@ inline constexpr uint64_t string_to_name(const char* str) {
     return name;
 }
 
-inline std::string name_to_string(uint64_t name) {
+// Writes up to 13 chars to dest. Returns the length.
+inline size_t name_to_chars(uint64_t name, char* dest) {
     static const char* charmap = ".12345abcdefghijklmnopqrstuvwxyz";
-    std::string str(13, '.');
-
     uint64_t tmp = name;
     for (uint32_t i = 0; i <= 12; ++i) {
-        char c = charmap[tmp & (i == 0 ? 0x0f : 0x1f)];
-        str[12 - i] = c;
+        dest[12 - i] = charmap[tmp & (i == 0 ? 0x0f : 0x1f)];
         tmp >>= (i == 0 ? 4 : 5);
     }
 
-    const auto last = str.find_last_not_of('.');
-    if (last != std::string::npos)
-        str = str.substr(0, last + 1);
+    size_t size = 13;
+    while (size && dest[size - 1] == '.')
+        --size;
+    return size ? size : 13;
+}
 
-    return str;
+inline std::string name_to_string(uint64_t name) {
+    char buf[13];
+    return std::string(buf, name_to_chars(name, buf));
 }
 
 struct name {
@@ -575,19 +897,22 @@ inline bool json_to_bin(name*, json_to_bin_state& state, const abi_type*, event_
         push_raw(state.bin, obj.value);
         return true;
     } else
-        throw std::runtime_error("expected string containing name");
+        return report_error(state, "expected string containing name");
 }
 
 inline bool bin_to_json(name*, bin_to_json_state& state, const abi_type*, bool start) {
-    auto s = std::string{name{read_bin<uint64_t>(state.bin)}};
-    return state.writer.String(s.c_str(), s.size());
+    uint64_t v;
+    if (!read_bin(state, v))
+        return false;
+    char s[13];
+    return state.writer.String(s, name_to_chars(v, s));
 }
 
 struct varuint32 {
     uint32_t value = 0;
 };
 
-inline void push_varuint32(std::vector<char>& bin, uint32_t v) {
+inline void push_varuint32(hooked_vector<char>& bin, uint32_t v) {
     uint64_t val = v;
     do {
         uint8_t b = val & 0x7f;
@@ -597,6 +922,24 @@ inline void push_varuint32(std::vector<char>& bin, uint32_t v) {
     } while (val);
 }
 
+inline size_t varuint32_size(uint32_t v) {
+    size_t size = 1;
+    while (v >>= 7)
+        ++size;
+    return size;
+}
+
+inline char* write_varuint32(char* dest, uint32_t v) {
+    uint64_t val = v;
+    do {
+        uint8_t b = val & 0x7f;
+        val >>= 7;
+        b |= ((val > 0) << 7);
+        *dest++ = b;
+    } while (val);
+    return dest;
+}
+
 inline uint32_t read_varuint32(input_buffer& bin) {
     uint32_t result = 0;
     int shift = 0;
@@ -609,20 +952,38 @@ inline uint32_t read_varuint32(input_buffer& bin) {
     return result;
 }
 
+inline bool read_varuint32(bin_to_json_state& state, uint32_t& dest) {
+    dest = 0;
+    int shift = 0;
+    uint8_t b = 0;
+    do {
+        if (state.bin.pos == state.bin.end)
+            return report_error(state, "read past end");
+        b = *state.bin.pos++;
+        dest |= (b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return true;
+}
+
 inline bool json_to_bin(varuint32*, json_to_bin_state& state, const abi_type*, event_type event, bool start) {
-    push_varuint32(state.bin, json_to_number<uint32_t>(state, event));
+    uint32_t v;
+    if (!json_to_number(v, state, event))
+        return false;
+    push_varuint32(state.bin, v);
     return true;
 }
 
 inline bool bin_to_json(varuint32*, bin_to_json_state& state, const abi_type*, bool start) {
-    return state.writer.Uint64(read_varuint32(state.bin));
+    uint32_t v;
+    return read_varuint32(state, v) && state.writer.Uint64(v);
 }
 
 struct varint32 {
     int32_t value = 0;
 };
 
-inline void push_varint32(std::vector<char>& bin, int32_t v) { push_varuint32(bin, uint32_t((v << 1) ^ (v >> 31))); }
+inline void push_varint32(hooked_vector<char>& bin, int32_t v) { push_varuint32(bin, uint32_t((v << 1) ^ (v >> 31))); }
 
 inline int32_t read_varint32(input_buffer& bin) {
     uint32_t v = read_varuint32(bin);
@@ -633,12 +994,18 @@ inline int32_t read_varint32(input_buffer& bin) {
 }
 
 inline bool json_to_bin(varint32*, json_to_bin_state& state, const abi_type*, event_type event, bool start) {
-    push_varint32(state.bin, json_to_number<int32_t>(state, event));
+    int32_t v;
+    if (!json_to_number(v, state, event))
+        return false;
+    push_varint32(state.bin, v);
     return true;
 }
 
 inline bool bin_to_json(varint32*, bin_to_json_state& state, const abi_type*, bool start) {
-    return state.writer.Int64(read_varint32(state.bin));
+    uint32_t v;
+    if (!read_varuint32(state, v))
+        return false;
+    return state.writer.Int64((v & 1) ? int32_t(((~v) >> 1) | 0x8000'0000) : int32_t(v >> 1));
 }
 
 struct time_point_sec {
@@ -648,8 +1015,9 @@ struct time_point_sec {
 
     explicit time_point_sec(uint32_t seconds) : utc_seconds{seconds} {}
 
-    explicit time_point_sec(const std::string& s) {
+    explicit time_point_sec(std::string_view sv) {
         static const boost::posix_time::ptime epoch = boost::posix_time::from_time_t(0);
+        std::string s{sv};
         boost::posix_time::ptime pt;
         if (s.size() >= 5 && s.at(4) == '-') // http://en.wikipedia.org/wiki/ISO_8601
             pt = boost::date_time::parse_delimited_time<boost::posix_time::ptime>(s, 'T');
@@ -664,20 +1032,37 @@ struct time_point_sec {
     }
 };
 
+// Parses the received string as T, reporting a malformed time through state.error. boost's parsers can only report by
+// throwing, so that's caught here rather than unwinding out of the reader.
+template <typename T>
+bool parse_time(T& obj, json_to_bin_state& state) {
+    try {
+        obj = T{state.received_data.value_string};
+        return true;
+    } catch (std::exception& e) {
+        return report_error(state, e.what());
+    }
+}
+
 inline bool json_to_bin(time_point_sec*, json_to_bin_state& state, const abi_type*, event_type event, bool start) {
     if (event == event_type::received_string) {
-        time_point_sec obj{state.received_data.value_string};
+        time_point_sec obj;
+        if (!parse_time(obj, state))
+            return false;
         if (trace_json_to_bin)
             printf("%*stime_point_sec: %s (%u) %s\n", int(state.stack.size() * 4), "",
                    state.received_data.value_string.c_str(), (unsigned)obj.utc_seconds, std::string{obj}.c_str());
         push_raw(state.bin, obj.utc_seconds);
         return true;
     } else
-        throw std::runtime_error("expected string containing time_point_sec");
+        return report_error(state, "expected string containing time_point_sec");
 }
 
 inline bool bin_to_json(time_point_sec*, bin_to_json_state& state, const abi_type*, bool start) {
-    auto s = std::string{time_point_sec{read_bin<uint32_t>(state.bin)}};
+    uint32_t v = 0;
+    if (!read_bin(state, v))
+        return false;
+    auto s = std::string{time_point_sec{v}};
     return state.writer.String(s.c_str(), s.size());
 }
 
@@ -688,12 +1073,12 @@ struct time_point {
 
     explicit time_point(uint64_t microseconds) : microseconds{microseconds} {}
 
-    explicit time_point(const std::string& s) {
+    explicit time_point(std::string_view s) {
         auto dot = s.find('.');
-        if (dot == std::string::npos)
+        if (dot == std::string_view::npos)
             microseconds = time_point_sec{s}.utc_seconds * 1000000ull;
         else {
-            auto ms = s.substr(dot);
+            auto ms = std::string{s.substr(dot)};
             ms[0] = '1';
             while (ms.size() < 4)
                 ms.push_back('0');
@@ -710,7 +1095,9 @@ struct time_point {
 
 inline bool json_to_bin(time_point*, json_to_bin_state& state, const abi_type*, event_type event, bool start) {
     if (event == event_type::received_string) {
-        time_point obj{state.received_data.value_string};
+        time_point obj;
+        if (!parse_time(obj, state))
+            return false;
         if (trace_json_to_bin)
             printf("%*stime_point: %s (%llu) %s\n", int(state.stack.size() * 4), "",
                    state.received_data.value_string.c_str(), (unsigned long long)obj.microseconds,
@@ -718,23 +1105,26 @@ inline bool json_to_bin(time_point*, json_to_bin_state& state, const abi_type*,
         push_raw(state.bin, obj.microseconds);
         return true;
     } else
-        throw std::runtime_error("expected string containing time_point");
+        return report_error(state, "expected string containing time_point");
 }
 
 inline bool bin_to_json(time_point*, bin_to_json_state& state, const abi_type*, bool start) {
-    auto s = std::string{time_point{read_bin<uint64_t>(state.bin)}};
+    uint64_t v;
+    if (!read_bin(state, v))
+        return false;
+    auto s = std::string{time_point{v}};
     return state.writer.String(s.c_str(), s.size());
 }
 
 struct block_timestamp {
     static constexpr uint16_t interval_ms = 500;
     static constexpr uint64_t epoch_ms = 946684800000ll; // Year 2000
-    uint32_t slot;
+    uint32_t slot = 0;
 
     block_timestamp() = default;
     explicit block_timestamp(uint32_t slot) : slot(slot) {}
     explicit block_timestamp(time_point t) { slot = (t.microseconds / 1000 - epoch_ms) / interval_ms; }
-    explicit block_timestamp(const std::string& s) : block_timestamp{time_point{s}} {}
+    explicit block_timestamp(std::string_view s) : block_timestamp{time_point{s}} {}
 
     explicit operator time_point() const { return time_point{(slot * (uint64_t)interval_ms + epoch_ms) * 1000}; }
     explicit operator std::string() const { return std::string{time_point{*this}}; }
@@ -742,18 +1132,23 @@ struct block_timestamp {
 
 inline bool json_to_bin(block_timestamp*, json_to_bin_state& state, const abi_type*, event_type event, bool start) {
     if (event == event_type::received_string) {
-        block_timestamp obj{state.received_data.value_string};
+        block_timestamp obj;
+        if (!parse_time(obj, state))
+            return false;
         if (trace_json_to_bin)
             printf("%*sblock_timestamp: %s (%u) %s\n", int(state.stack.size() * 4), "",
                    state.received_data.value_string.c_str(), (unsigned)obj.slot, std::string{obj}.c_str());
         push_raw(state.bin, obj.slot);
         return true;
     } else
-        throw std::runtime_error("expected string containing block_timestamp");
+        return report_error(state, "expected string containing block_timestamp");
 }
 
 inline bool bin_to_json(block_timestamp*, bin_to_json_state& state, const abi_type*, bool start) {
-    auto s = std::string{block_timestamp{read_bin<uint32_t>(state.bin)}};
+    uint32_t v;
+    if (!read_bin(state, v))
+        return false;
+    auto s = std::string{block_timestamp{v}};
     return state.writer.String(s.c_str(), s.size());
 }
 
@@ -771,8 +1166,29 @@ inline constexpr uint64_t string_to_symbol_code(const char* str) {
     return result;
 }
 
-inline std::string symbol_code_to_string(uint64_t v) {
-    std::string result;
+// The checked parsers below skip leading spaces and report malformed input by returning false
+
+// Reads 1 to 7 capital letters, advancing s past them
+inline bool read_symbol_code(const char*& s, uint64_t& result) {
+    result = 0;
+    uint32_t i = 0;
+    for (; *s >= 'A' && *s <= 'Z'; ++i) {
+        if (i == 7)
+            return false;
+        result |= uint64_t(*s++) << (8 * i);
+    }
+    return i;
+}
+
+inline bool string_to_symbol_code(const char* s, uint64_t& result) {
+    while (*s == ' ')
+        ++s;
+    return read_symbol_code(s, result) && !*s;
+}
+
+template <typename String = std::string>
+String symbol_code_to_string(uint64_t v) {
+    String result;
     while (v > 0) {
         result += char(v & 0xFF);
         v >>= 8;
@@ -785,15 +1201,20 @@ inline bool json_to_bin(symbol_code*, json_to_bin_state& state, const abi_type*,
         auto& s = state.received_data.value_string;
         if (trace_json_to_bin)
             printf("%*ssymbol_code: %s\n", int(state.stack.size() * 4), "", s.c_str());
-        auto v = string_to_symbol_code(s.c_str());
+        uint64_t v;
+        if (!string_to_symbol_code(s.c_str(), v))
+            return report_error(state, "invalid symbol_code");
         push_raw(state.bin, v);
         return true;
     } else
-        throw std::runtime_error("expected string containing symbol_code");
+        return report_error(state, "expected string containing symbol_code");
 }
 
 inline bool bin_to_json(symbol_code*, bin_to_json_state& state, const abi_type*, bool start) {
-    std::string result{symbol_code_to_string(read_bin<uint64_t>(state.bin))};
+    uint64_t v = 0;
+    if (!read_bin(state, v))
+        return false;
+    auto result = symbol_code_to_string<arena_string>(v);
     return state.writer.String(result.c_str(), result.size());
 }
 
@@ -814,8 +1235,33 @@ inline constexpr uint64_t string_to_symbol(const char* str) {
     return string_to_symbol(precision, str);
 }
 
-inline std::string symbol_to_string(uint64_t v) {
-    return std::to_string(v & 0xff) + "," + symbol_code_to_string(v >> 8);
+constexpr uint8_t max_symbol_precision = 18;
+
+// "precision,CODE"
+inline bool string_to_symbol(const char* s, uint64_t& result) {
+    while (*s == ' ')
+        ++s;
+    uint8_t precision = 0;
+    if (*s < '0' || *s > '9')
+        return false;
+    while (*s >= '0' && *s <= '9') {
+        precision = precision * 10 + (*s++ - '0');
+        if (precision > max_symbol_precision)
+            return false;
+    }
+    uint64_t code;
+    if (*s++ != ',' || !read_symbol_code(s, code) || *s)
+        return false;
+    result = code << 8 | precision;
+    return true;
+}
+
+template <typename String = std::string>
+String symbol_to_string(uint64_t v) {
+    char precision[4];
+    auto result = String(precision, std::to_chars(precision, precision + sizeof(precision), v & 0xff).ptr);
+    result += ',';
+    return result + symbol_code_to_string<String>(v >> 8);
 }
 
 inline bool json_to_bin(symbol*, json_to_bin_state& state, const abi_type*, event_type event, bool start) {
@@ -823,15 +1269,20 @@ inline bool json_to_bin(symbol*, json_to_bin_state& state, const abi_type*, even
         auto& s = state.received_data.value_string;
         if (trace_json_to_bin)
             printf("%*ssymbol: %s\n", int(state.stack.size() * 4), "", s.c_str());
-        auto v = string_to_symbol(s.c_str());
+        uint64_t v;
+        if (!string_to_symbol(s.c_str(), v))
+            return report_error(state, "invalid symbol");
         push_raw(state.bin, v);
         return true;
     } else
-        throw std::runtime_error("expected string containing symbol");
+        return report_error(state, "expected string containing symbol");
 }
 
 inline bool bin_to_json(symbol*, bin_to_json_state& state, const abi_type*, bool start) {
-    std::string result{symbol_to_string(read_bin<uint64_t>(state.bin))};
+    uint64_t v;
+    if (!read_bin(state, v))
+        return false;
+    auto result = symbol_to_string<arena_string>(v);
     return state.writer.String(result.c_str(), result.size());
 }
 
@@ -840,34 +1291,49 @@ struct asset {
     symbol sym{};
 };
 
-inline asset string_to_asset(const char* s) {
-    // todo: check overflow
+// "[-]digits[.digits] CODE". The amount, ignoring its decimal point, must fit in an int64_t.
+inline bool string_to_asset(const char* s, asset& result) {
     while (*s == ' ')
         ++s;
+    bool negative = *s == '-';
+    if (negative)
+        ++s;
     uint64_t amount = 0;
     uint8_t precision = 0;
-    bool negative = false;
-    if (*s == '-') {
-        ++s;
-        negative = true;
-    }
+    auto read_digit = [&] {
+        uint64_t digit = *s++ - '0';
+        if (amount > (uint64_t(std::numeric_limits<int64_t>::max()) - digit) / 10)
+            return false;
+        amount = amount * 10 + digit;
+        return true;
+    };
+    if (*s < '0' || *s > '9')
+        return false;
     while (*s >= '0' && *s <= '9')
-        amount = amount * 10 + (*s++ - '0');
+        if (!read_digit())
+            return false;
     if (*s == '.') {
         ++s;
-        while (*s >= '0' && *s <= '9') {
-            amount = amount * 10 + (*s++ - '0');
-            ++precision;
-        }
+        if (*s < '0' || *s > '9')
+            return false;
+        while (*s >= '0' && *s <= '9')
+            if (!read_digit() || ++precision > max_symbol_precision)
+                return false;
     }
-    if (negative)
-        amount = -amount;
-    auto code = string_to_symbol_code(s);
-    return asset{(int64_t)amount, symbol{(code << 8) | precision}};
+    if (*s != ' ')
+        return false;
+    while (*s == ' ')
+        ++s;
+    uint64_t code;
+    if (!read_symbol_code(s, code) || *s)
+        return false;
+    result = asset{negative ? -int64_t(amount) : int64_t(amount), symbol{code << 8 | precision}};
+    return true;
 }
 
-inline std::string asset_to_string(const asset& v) {
-    std::string result;
+template <typename String = std::string>
+String asset_to_string(const asset& v) {
+    String result;
     uint64_t amount;
     if (v.amount < 0)
         amount = -v.amount;
@@ -888,7 +1354,8 @@ inline std::string asset_to_string(const asset& v) {
     if (v.amount < 0)
         result += '-';
     std::reverse(result.begin(), result.end());
-    return result + ' ' + symbol_code_to_string(v.sym.value >> 8);
+    result += ' ';
+    return result + symbol_code_to_string<String>(v.sym.value >> 8);
 }
 
 inline bool json_to_bin(asset*, json_to_bin_state& state, const abi_type*, event_type event, bool start) {
@@ -896,19 +1363,21 @@ inline bool json_to_bin(asset*, json_to_bin_state& state, const abi_type*, event
         auto& s = state.received_data.value_string;
         if (trace_json_to_bin)
             printf("%*sasset: %s\n", int(state.stack.size() * 4), "", s.c_str());
-        auto v = string_to_asset(s.c_str());
+        asset v;
+        if (!string_to_asset(s.c_str(), v))
+            return report_error(state, "invalid asset");
         push_raw(state.bin, v.amount);
         push_raw(state.bin, v.sym.value);
         return true;
     } else
-        throw std::runtime_error("expected string containing asset");
+        return report_error(state, "expected string containing asset");
 }
 
 inline bool bin_to_json(asset*, bin_to_json_state& state, const abi_type*, bool start) {
     asset v{};
-    read_bin(state.bin, v.amount);
-    read_bin(state.bin, v.sym.value);
-    auto s = asset_to_string(v);
+    if (!read_bin(state, v.amount) || !read_bin(state, v.sym.value))
+        return false;
+    auto s = asset_to_string<arena_string>(v);
     return state.writer.String(s.c_str(), s.size());
 }
 
@@ -1209,23 +1678,26 @@ inline bool receive_event(struct json_to_native_state& state, event_type event,
     return x.ser && x.ser->json_to_native(x.obj, state, event, start);
 }
 
+// On failure, error receives the reason if a serializer reported one
 template <typename T>
-bool json_to_native(T& obj, std::string_view json) {
+bool json_to_native(T& obj, std::string_view json, hooked_string& error) {
     std::string mutable_json{json};
     json_to_native_state state;
     state.stack.push_back(native_stack_entry{&obj, &native_serializer_for<T>, 0});
     rapidjson::Reader reader;
     rapidjson::InsituStringStream ss(mutable_json.data());
-    return reader.Parse<rapidjson::kParseValidateEncodingFlag | rapidjson::kParseIterativeFlag |
-                        rapidjson::kParseNumbersAsStringsFlag>(ss, state);
+    if (reader.Parse<rapidjson::kParseValidateEncodingFlag | rapidjson::kParseIterativeFlag |
+                     rapidjson::kParseNumbersAsStringsFlag>(ss, state))
+        return true;
+    error = std::move(state.error);
+    return false;
 }
 
 template <typename T>
 auto json_to_native(T& obj, json_to_native_state& state, event_type event, bool start)
     -> std::enable_if_t<std::is_arithmetic_v<T>, bool> {
 
-    obj = json_to_number<T>(state, event);
-    return true;
+    return json_to_number(obj, state, event);
 }
 
 template <typename T>
@@ -1252,7 +1724,8 @@ auto json_to_native(T& obj, json_to_native_state& state, event_type event, bool
                native_field_serializers_for<T>[stack_entry.position].name != state.received_data.key)
             ++stack_entry.position;
         if (stack_entry.position >= (ptrdiff_t)native_field_serializers_for<T>.size())
-            throw std::runtime_error("unknown field " + state.received_data.key); // TODO: eat unknown subtree
+            throw std::runtime_error("unknown field " +
+                                     std::string{state.received_data.key}); // TODO: eat unknown subtree
         return true;
     } else if (stack_entry.position < (ptrdiff_t)native_field_serializers_for<T>.size()) {
         auto& field_ser = native_field_serializers_for<T>[stack_entry.position];
@@ -1344,270 +1817,1372 @@ constexpr void for_each_abi_type(F f) {
     f("asset", (asset*)nullptr);
 }
 
-template <typename T>
-struct abi_serializer_impl : abi_serializer {
-    bool json_to_bin(json_to_bin_state& state, const abi_type* type, event_type event, bool start) const override {
-        return ::abieos::json_to_bin((T*)nullptr, state, type, event, start);
-    }
-    bool bin_to_json(bin_to_json_state& state, const abi_type* type, bool start) const override {
-        return ::abieos::bin_to_json((T*)nullptr, state, type, start);
-    }
+// Converts one value of a builtin type; plans call these directly. Optionals, arrays and structs have none; plans
+// expand them instead.
+struct abi_converter {
+    json_to_bin_fn* json_to_bin = nullptr;
+    bin_to_json_fn* bin_to_json = nullptr;
 };
 
 template <typename T>
-inline constexpr auto abi_serializer_for = abi_serializer_impl<T>{};
+constexpr abi_converter abi_converter_for() {
+    return {[](json_to_bin_state& state, event_type event) {
+                return ::abieos::json_to_bin((T*)nullptr, state, nullptr, event, true);
+            },
+            [](bin_to_json_state& state) { return ::abieos::bin_to_json((T*)nullptr, state, nullptr, true); }};
+}
+
+// By position in for_each_abi_type. Compiled contracts refer to converters by position rather than by address, since
+// addresses differ between processes.
+inline constexpr auto abi_converters = [] {
+    std::array<abi_converter, 31> converters{};
+    size_t i = 0;
+    for_each_abi_type([&](const char*, auto* p) { converters[i++] = abi_converter_for<std::decay_t<decltype(*p)>>(); });
+    return i == converters.size() ? converters : throw std::logic_error("abi_converters has the wrong size");
+}();
 
 ///////////////////////////////////////////////////////////////////////////////
 // abi handling
 ///////////////////////////////////////////////////////////////////////////////
 
-struct abi_field {
-    std::string name{};
-    struct abi_type* type{};
+// What create_contract needs from an abi: views of its types, structs and actions, either into the abi's binary form
+// (see read_abi_view) or into an abi_def. The fields of all structs share one array.
+struct type_def_view {
+    std::string_view new_type_name{};
+    std::string_view type{};
 };
 
-struct abi_type {
-    std::string name{};
-    std::string alias_of_name{};
-    const ::abieos::struct_def* struct_def{};
-    abi_type* alias_of{};
-    abi_type* optional_of{};
-    abi_type* array_of{};
-    abi_type* base{};
-    std::vector<abi_field> fields{};
-    bool filled_struct{};
-    const abi_serializer* ser{};
+struct field_def_view {
+    std::string_view name{};
+    std::string_view type{};
 };
 
-struct contract {
-    std::map<name, std::string> action_types;
-    std::map<std::string, abi_type> abi_types;
+struct struct_def_view {
+    std::string_view name{};
+    std::string_view base{};
+    uint32_t begin_field{}; // into abi_view::fields
+    uint32_t end_field{};
 };
 
-template <int i>
-bool ends_with(const std::string& s, const char (&suffix)[i]) {
-    return s.size() >= i - 1 && !strcmp(s.c_str() + s.size() - (i - 1), suffix);
-}
+struct action_def_view {
+    ::abieos::name name{};
+    std::string_view type{};
+};
 
-inline abi_type& get_type(std::map<std::string, abi_type>& abi_types, const std::string& name, int depth) {
-    if (depth >= 32)
-        throw std::runtime_error("abi recursion limit reached");
-    auto it = abi_types.find(name);
-    if (it == abi_types.end()) {
-        if (ends_with(name, "?")) {
-            abi_type type{name};
-            type.optional_of = &get_type(abi_types, name.substr(0, name.size() - 1), depth + 1);
-            if (type.optional_of->optional_of || type.optional_of->array_of)
-                throw std::runtime_error("optional and array don't support nesting");
-            type.ser = &abi_serializer_for<pseudo_optional>;
-            return abi_types[name] = std::move(type);
-        } else if (ends_with(name, "[]")) {
-            abi_type type{name};
-            type.array_of = &get_type(abi_types, name.substr(0, name.size() - 2), depth + 1);
-            if (type.array_of->array_of || type.array_of->optional_of)
-                throw std::runtime_error("optional and array don't support nesting");
-            type.ser = &abi_serializer_for<pseudo_array>;
-            return abi_types[name] = std::move(type);
-        } else
-            throw std::runtime_error("unknown type \"" + name + "\"");
+struct abi_view {
+    hooked_vector<type_def_view> types{};
+    hooked_vector<struct_def_view> structs{};
+    hooked_vector<field_def_view> fields{};
+    hooked_vector<action_def_view> actions{};
+};
+
+inline abi_view make_abi_view(const abi_def& abi) {
+    abi_view view;
+    view.types.reserve(abi.types.size());
+    for (auto& t : abi.types)
+        view.types.push_back({t.new_type_name, t.type});
+    view.structs.reserve(abi.structs.size());
+    for (auto& s : abi.structs) {
+        auto begin = uint32_t(view.fields.size());
+        for (auto& f : s.fields)
+            view.fields.push_back({f.name, f.type});
+        view.structs.push_back({s.name, s.base, begin, uint32_t(view.fields.size())});
     }
-    if (it->second.alias_of)
-        return *it->second.alias_of;
-    if (it->second.alias_of_name.empty())
-        return it->second;
-    auto& other = get_type(abi_types, it->second.alias_of_name, depth + 1);
-    it->second.alias_of = &other;
-    return other;
+    view.actions.reserve(abi.actions.size());
+    for (auto& a : abi.actions)
+        view.actions.push_back({a.name, a.type});
+    return view;
 }
 
-inline abi_type& fill_struct(std::map<std::string, abi_type>& abi_types, abi_type& type, int depth) {
-    if (depth >= 32)
-        throw std::runtime_error("abi recursion limit reached");
-    if (type.filled_struct)
-        return type;
-    if (!type.struct_def)
-        throw std::runtime_error("abi type \"" + type.name + "\" is not a struct");
-    if (!type.struct_def->base.empty())
-        type.fields = fill_struct(abi_types, get_type(abi_types, type.struct_def->base, depth + 1), depth + 1).fields;
-    for (auto& field : type.struct_def->fields)
-        type.fields.push_back(abi_field{field.name, &get_type(abi_types, field.type, depth + 1)});
-    type.filled_struct = true;
-    return type;
-}
-
-inline contract create_contract(const abi_def& abi) {
-    contract c;
-    for (auto& a : abi.actions)
-        c.action_types[a.name] = a.type;
-    for_each_abi_type([&](const char* name, auto* p) {
-        abi_type type{name};
-        type.ser = &abi_serializer_for<std::decay_t<decltype(*p)>>;
-        c.abi_types.insert({name, std::move(type)});
-    });
-    {
-        abi_type type{"extended_asset"};
-        type.fields.push_back(abi_field{"quantity", &get_type(c.abi_types, "asset", 0)});
-        type.fields.push_back(abi_field{"contract", &get_type(c.abi_types, "name", 0)});
+inline std::string_view read_string_view(input_buffer& bin) {
+    auto size = read_varuint32(bin);
+    if (size >= bin.end - bin.pos)
+        throw std::runtime_error("invalid string size");
+    std::string_view result{bin.pos, size};
+    bin.pos += size;
+    return result;
+}
+
+// Reads a binary abi in one pass without copying any of it; view refers into bin. The sections create_contract doesn't
+// use (ricardian contracts and clauses, tables, error messages and extensions) are read only far enough to skip them.
+// Accepts and rejects the same abis as bin_to_native(abi_def&, ...).
+inline void read_abi_view(abi_view& view, input_buffer bin) {
+    // Each entry takes at least one byte, so this never reserves more than bin's size
+    auto read_count = [&](auto& v) {
+        auto n = read_varuint32(bin);
+        v.reserve(v.size() + std::min<size_t>(n, bin.end - bin.pos));
+        return n;
+    };
+    auto skip_strings = [&] {
+        for (auto n = read_varuint32(bin); n; --n)
+            read_string_view(bin);
+    };
+
+    read_string_view(bin); // version
+    for (auto n = read_count(view.types); n; --n) {
+        auto new_type_name = read_string_view(bin);
+        view.types.push_back({new_type_name, read_string_view(bin)});
+    }
+    for (auto n = read_count(view.structs); n; --n) {
+        struct_def_view s;
+        s.name = read_string_view(bin);
+        s.base = read_string_view(bin);
+        s.begin_field = view.fields.size();
+        for (auto m = read_count(view.fields); m; --m) {
+            auto name = read_string_view(bin);
+            view.fields.push_back({name, read_string_view(bin)});
+        }
+        s.end_field = view.fields.size();
+        view.structs.push_back(s);
+    }
+    for (auto n = read_count(view.actions); n; --n) {
+        action_def_view a;
+        read_bin(bin, a.name.value);
+        a.type = read_string_view(bin);
+        read_string_view(bin); // ricardian_contract
+        view.actions.push_back(a);
+    }
+    for (auto n = read_varuint32(bin); n; --n) { // tables
+        read_bin<uint64_t>(bin);
+        read_string_view(bin);
+        skip_strings();
+        skip_strings();
+        read_string_view(bin);
+    }
+    for (auto n = read_varuint32(bin); n; --n) { // ricardian_clauses
+        read_string_view(bin);
+        read_string_view(bin);
+    }
+    for (auto n = read_varuint32(bin); n; --n) { // error_messages
+        read_bin<uint64_t>(bin);
+        read_string_view(bin);
+    }
+    for (auto n = read_varuint32(bin); n; --n) { // abi_extensions
+        read_bin<uint16_t>(bin);
+        auto size = read_varuint32(bin);
+        if (size > bin.end - bin.pos)
+            throw std::runtime_error("read past end");
+        bin.pos += size;
+    }
+}
+
+// A link to something in the same block, held as its offset from the link, so a block of them means the same wherever
+// it's mapped. Each contract is one block, and so is the builtin table; nothing links between blocks.
+template <typename T>
+struct rel_ptr {
+    static_assert(std::is_const_v<T>, "blocks are immutable once laid out");
+
+    int32_t offset = 0; // null if 0; nothing links to itself
+
+    rel_ptr() = default;
+    rel_ptr(const rel_ptr&) = delete; // a copy would point somewhere else
+    rel_ptr& operator=(const rel_ptr&) = delete;
+
+    rel_ptr& operator=(T* p) {
+        offset = p ? int32_t(reinterpret_cast<const char*>(p) - reinterpret_cast<const char*>(this)) : 0;
+        return *this;
+    }
+
+    T* get() const { return offset ? reinterpret_cast<T*>(reinterpret_cast<const char*>(this) + offset) : nullptr; }
+    operator T*() const { return get(); }
+    T* operator->() const { return get(); }
+};
+
+template <typename T>
+struct rel_array {
+    rel_ptr<T> first{};
+    uint32_t count = 0;
+
+    void assign(T* p, size_t n) {
+        first = n ? p : nullptr;
+        count = n;
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return !count; }
+    T& operator[](size_t i) const { return first.get()[i]; }
+    T* begin() const { return first; }
+    T* end() const { return first.get() + count; }
+};
+
+// A name in the block's names
+struct rel_string : rel_array<const char> {
+    const char* data() const { return first; }
+    operator std::string_view() const { return {first, count}; }
+};
+
+enum class abi_type_kind : uint8_t {
+    value, // converted by abi_converters[converter]
+    optional,
+    array,
+    object,
+    invalid, // a type without a converter
+};
+
+struct abi_field {
+    rel_string name{};
+    rel_ptr<const struct abi_type> type{};
+};
+
+// A compiled type: an entry in the types of a contract, or of the builtin table. Aliases are resolved while compiling,
+// so they have no entries of their own.
+struct abi_type {
+    rel_string name{};
+    abi_type_kind kind{};
+    uint8_t converter{}; // into abi_converters
+    rel_ptr<const abi_type> optional_of{};
+    rel_ptr<const abi_type> array_of{};
+    rel_array<const abi_field> fields{}; // a derived struct's start with its base's, and share them where they can
+    rel_ptr<const struct plan_op> plan{}; // converts a value of this type either way; see plan_conversions
+
+    bool is_struct() const { return kind == abi_type_kind::object; }
+};
+static_assert(sizeof(abi_type) <= 32);
+
+enum class plan_op_kind : uint8_t {
+    value,      // converted by abi_converters[converter]
+    name,       // the most common value, converted inline
+    optional,   // the presence flag; if absent, the value is null and target skips its ops
+    object,     // enters the struct whose body begins at target
+    key,        // a field's name; target is its position
+    end_object, // returns to the op after the caller's
+    array,      // the size, then enters the array whose body, an item op, begins at target
+    item,       // the next item, or, if there are no more, returns to the op after the caller's
+    next_item,  // jumps back to the item op at target
+    done,
+    invalid, // a type without a converter
+};
+
+// One step of a conversion plan. bin_to_json runs through a plan; json_to_bin steps through it as the parser reports
+// each event. Targets are relative to the op itself.
+struct plan_op {
+    plan_op_kind kind{};
+    uint8_t converter{}; // into abi_converters
+    int32_t target{};
+    rel_string key{};
+    rel_ptr<const abi_type> type{}; // of a struct or array
+};
+
+struct type_index_entry {
+    rel_string name{};
+    rel_ptr<const abi_type> type{};
+};
+
+struct action_type_entry {
+    name action{};
+    rel_string type{};
+};
+
+// A compiled contract's tables, laid out by lay_out_contract in one block which holds no addresses, only links within
+// itself and positions in this build's tables. An image from a registry file is used where it's mapped, so processes
+// sharing a registry share its contracts.
+struct contract_image {
+    uint64_t layout{}; // contract_image_layout of the build which laid it out
+    uint64_t size{};   // of the whole block
+    rel_array<const abi_type> types{};
+    rel_array<const plan_op> plan_ops{};
+    rel_array<const type_index_entry> type_index{}; // including aliases
+    rel_array<const uint32_t> type_slots{};         // by type_name_hash, open addressing; 1 + index into type_index
+    rel_array<const abi_field> fields{};
+    rel_array<const action_type_entry> actions{}; // ordered by action
+    rel_string names{};                           // each name once
+};
+
+// A compiled contract: an image which it owns, or which is part of a mapped file. May be moved but not copied.
+struct contract {
+    hooked_vector<uint64_t> storage{}; // the image, unless it's mapped
+    const contract_image* image = nullptr;
+
+    contract() = default;
+    explicit contract(const contract_image* image) : image{image} {}
+    contract(contract&&) = default;
+    contract& operator=(contract&&) = default;
+
+    std::string_view bytes() const { return {reinterpret_cast<const char*>(image), size_t(image->size)}; }
+};
+
+template <int i>
+bool ends_with(std::string_view s, const char (&suffix)[i]) {
+    return s.size() >= i - 1 && s.substr(s.size() - (i - 1)) == suffix;
+}
+
+// The builtin types, each with its T[] and T?, in one table which every contract shares. Their names are hashed
+// perfectly at compile time, so finding one costs a hash and a single comparison. All but extended_asset are in
+// for_each_abi_type's order, so a type's position here is also its converter's.
+constexpr auto builtin_type_names = [] {
+    std::array<std::string_view, 32> names{};
+    size_t i = 0;
+    for_each_abi_type([&](const char* name, auto*) { names[i++] = name; });
+    names[i++] = "extended_asset";
+    return i == names.size() ? names : throw std::logic_error("builtin_type_names has the wrong size");
+}();
+
+constexpr uint8_t name_converter = [] {
+    uint8_t i = 0;
+    while (builtin_type_names[i] != "name")
+        ++i;
+    return i;
+}();
+
+// Changes whenever this build lays out images differently from another, or numbers converters differently
+inline constexpr uint64_t contract_image_layout = [] {
+    uint64_t hash = 0xcbf2'9ce4'8422'2325; // FNV-1a
+    auto add = [&](uint64_t v) {
+        hash ^= v;
+        hash *= 0x100'0000'01b3;
+    };
+    add(1);
+    for (auto size : {sizeof(contract_image), sizeof(abi_type), sizeof(abi_field), sizeof(plan_op),
+                      sizeof(type_index_entry), sizeof(action_type_entry)})
+        add(size);
+    for (auto name : builtin_type_names) {
+        for (auto c : name)
+            add(uint8_t(c));
+        add(0x100);
+    }
+    return hash;
+}();
+
+constexpr uint32_t type_name_hash(std::string_view name, uint32_t seed) {
+    uint32_t hash = seed ^ 0x811c'9dc5; // FNV-1a
+    for (auto c : name) {
+        hash ^= uint8_t(c);
+        hash *= 0x0100'0193;
+    }
+    return hash;
+}
+
+// A contract's tables before lay_out_contract puts them in an image. Types and fields link by index.
+struct contract_def {
+    static constexpr uint32_t none = -1;
+
+    struct type {
+        std::string_view name{};
+        abi_type_kind kind = abi_type_kind::invalid;
+        uint8_t converter = 0;
+        uint32_t optional_of = none;
+        uint32_t array_of = none;
+        uint32_t begin_field = 0; // into fields
+        uint32_t end_field = 0;
+    };
+
+    struct field {
+        std::string_view name{};
+        uint32_t type = none;
+    };
+
+    hooked_vector<type> types{};
+    hooked_vector<field> fields{};
+    hooked_vector<std::pair<std::string_view, uint32_t>> type_index{}; // including aliases
+    hooked_vector<std::pair<name, std::string_view>> actions{};        // ordered by name
+};
+
+struct plan_op_def {
+    plan_op_kind kind{};
+    uint8_t converter{};
+    int32_t target{};
+    uint32_t type = contract_def::none;
+    uint32_t field = contract_def::none; // of a key
+};
+
+// Compiles conversions of def's types into flat plans in ops, and sets plans[i] to where the plan of def.types[i]
+// starts. A type's plan converts one value and ends with done; it enters a struct or array by jumping to the body
+// shared by all plans which contain one. Bodies are appended once each, after the plans.
+inline void plan_conversions(const contract_def& def, hooked_vector<plan_op_def>& ops, hooked_vector<uint32_t>& plans) {
+    const uint32_t none = contract_def::none;
+    hooked_vector<uint32_t> bodies(def.types.size(), none);
+    hooked_vector<size_t> entries; // object and array ops
+    auto add = [&](plan_op_kind kind, uint32_t type = contract_def::none) {
+        ops.push_back({kind});
+        ops.back().type = type;
+        return ops.size() - 1;
+    };
+    auto add_value = [&](uint32_t i, auto& add_value) -> void {
+        auto& type = def.types[i];
+        switch (type.kind) {
+        case abi_type_kind::value:
+            if (type.converter == name_converter)
+                add(plan_op_kind::name);
+            else
+                ops[add(plan_op_kind::value)].converter = type.converter;
+            break;
+        case abi_type_kind::optional: {
+            auto op = add(plan_op_kind::optional);
+            add_value(type.optional_of, add_value);
+            ops[op].target = ops.size() - op;
+            break;
+        }
+        case abi_type_kind::array:
+            entries.push_back(add(plan_op_kind::array, i));
+            break;
+        case abi_type_kind::object:
+            entries.push_back(add(plan_op_kind::object, i));
+            break;
+        case abi_type_kind::invalid:
+            add(plan_op_kind::invalid);
+            break;
+        }
+    };
+
+    size_t num_ops = 0; // exact unless fields or items are optional
+    for (auto& t : def.types) {
+        num_ops += t.kind == abi_type_kind::object     ? (t.end_field - t.begin_field) * 2 + 3
+                   : t.kind == abi_type_kind::array    ? 5
+                   : t.kind == abi_type_kind::optional ? 3
+                                                       : 2;
+    }
+    ops.reserve(ops.size() + num_ops);
+    entries.reserve(def.types.size());
+    plans.resize(def.types.size());
+    for (uint32_t i = 0; i < def.types.size(); ++i) {
+        plans[i] = ops.size();
+        add_value(i, add_value);
+        add(plan_op_kind::done);
+    }
+    for (size_t i = 0; i < entries.size(); ++i) { // adding a body may add entries
+        auto op = entries[i];
+        auto& type = def.types[ops[op].type];
+        auto& start = bodies[ops[op].type];
+        if (start == none) {
+            start = ops.size();
+            if (type.kind == abi_type_kind::object) {
+                for (auto j = type.begin_field; j < type.end_field; ++j) {
+                    auto key = add(plan_op_kind::key);
+                    ops[key].target = j - type.begin_field;
+                    ops[key].field = j;
+                    add_value(def.fields[j].type, add_value);
+                }
+                add(plan_op_kind::end_object);
+            } else {
+                add(plan_op_kind::item);
+                add_value(type.array_of, add_value);
+                auto next = add(plan_op_kind::next_item);
+                ops[next].target = start - next;
+            }
+        }
+        ops[op].target = start - op;
+    }
+}
+
+// Plans def's conversions and lays out def and the plans in one image, interning every name
+inline contract lay_out_contract(const contract_def& def) {
+    hooked_vector<plan_op_def> op_defs;
+    hooked_vector<uint32_t> plans;
+    plan_conversions(def, op_defs, plans);
+
+    // Interns every name, through an open-addressed table like type_slots
+    size_t num_names = def.types.size() + def.fields.size() + def.type_index.size() + def.actions.size();
+    size_t name_mask = 1;
+    while (name_mask < num_names * 2)
+        name_mask *= 2;
+    name_mask -= 1;
+    hooked_vector<std::pair<std::string_view, uint32_t>> unique_names; // with offsets into the image's names
+    hooked_vector<uint32_t> name_slots(name_mask + 1);                  // 1 + index into unique_names
+    hooked_vector<uint32_t> offsets;                                    // of each name below, in order
+    unique_names.reserve(num_names);
+    offsets.reserve(num_names);
+    uint64_t name_bytes = 0;
+    auto intern = [&](std::string_view name) {
+        auto slot = type_name_hash(name, 0) & name_mask;
+        for (; name_slots[slot]; slot = (slot + 1) & name_mask) {
+            auto& [other, offset] = unique_names[name_slots[slot] - 1];
+            if (other == name)
+                return offsets.push_back(offset);
+        }
+        unique_names.push_back({name, uint32_t(name_bytes)});
+        name_slots[slot] = unique_names.size();
+        offsets.push_back(name_bytes);
+        name_bytes += name.size();
+    };
+    for (auto& t : def.types)
+        intern(t.name);
+    for (auto& f : def.fields)
+        intern(f.name);
+    for (auto& [name, _] : def.type_index)
+        intern(name);
+    for (auto& [_, type] : def.actions)
+        intern(type);
+    const uint32_t* type_names = offsets.data();
+    const uint32_t* field_names = type_names + def.types.size(); // keys repeat them, often many times each
+    const uint32_t* index_names = field_names + def.fields.size();
+    const uint32_t* action_names = index_names + def.type_index.size();
+
+    size_t num_slots = 1;
+    while (num_slots < def.type_index.size() * 2)
+        num_slots *= 2;
+
+    uint64_t size = sizeof(contract_image);
+    auto place = [&](auto* type, size_t count) {
+        using T = std::remove_pointer_t<decltype(type)>;
+        size = (size + alignof(T) - 1) / alignof(T) * alignof(T);
+        auto offset = size;
+        size += uint64_t(count) * sizeof(T);
+        return offset;
+    };
+    auto types_at = place((abi_type*)nullptr, def.types.size());
+    auto ops_at = place((plan_op*)nullptr, op_defs.size());
+    auto index_at = place((type_index_entry*)nullptr, def.type_index.size());
+    auto slots_at = place((uint32_t*)nullptr, num_slots);
+    auto fields_at = place((abi_field*)nullptr, def.fields.size());
+    auto actions_at = place((action_type_entry*)nullptr, def.actions.size());
+    auto names_at = place((char*)nullptr, name_bytes);
+    if (size > uint64_t(std::numeric_limits<int32_t>::max()))
+        throw std::runtime_error("abi is too large");
+
+    contract c;
+    c.storage.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    auto* base = reinterpret_cast<char*>(c.storage.data());
+    auto construct = [&](auto* type, uint64_t offset, size_t count) {
+        using T = std::remove_pointer_t<decltype(type)>;
+        auto* first = reinterpret_cast<T*>(base + offset);
+        for (size_t i = 0; i < count; ++i)
+            new (first + i) T{};
+        return first;
+    };
+    auto* image = construct((contract_image*)nullptr, 0, 1);
+    auto* types = construct((abi_type*)nullptr, types_at, def.types.size());
+    auto* ops = construct((plan_op*)nullptr, ops_at, op_defs.size());
+    auto* index = construct((type_index_entry*)nullptr, index_at, def.type_index.size());
+    auto* slots = construct((uint32_t*)nullptr, slots_at, num_slots);
+    auto* fields = construct((abi_field*)nullptr, fields_at, def.fields.size());
+    auto* actions = construct((action_type_entry*)nullptr, actions_at, def.actions.size());
+    auto* names = base + names_at;
+    for (auto& [name, offset] : unique_names)
+        memcpy(names + offset, name.data(), name.size());
+    auto link = [&](uint32_t i) -> const abi_type* { return i == contract_def::none ? nullptr : &types[i]; };
+
+    for (size_t i = 0; i < def.types.size(); ++i) {
+        auto& d = def.types[i];
+        auto& t = types[i];
+        t.name.assign(names + type_names[i], d.name.size());
+        t.kind = d.kind;
+        t.converter = d.converter;
+        t.optional_of = link(d.optional_of);
+        t.array_of = link(d.array_of);
+        t.fields.assign(fields + d.begin_field, d.end_field - d.begin_field);
+        t.plan = &ops[plans[i]];
+    }
+    for (size_t i = 0; i < def.fields.size(); ++i) {
+        fields[i].name.assign(names + field_names[i], def.fields[i].name.size());
+        fields[i].type = link(def.fields[i].type);
+    }
+    for (size_t i = 0; i < op_defs.size(); ++i) {
+        auto& d = op_defs[i];
+        ops[i].kind = d.kind;
+        ops[i].converter = d.converter;
+        ops[i].target = d.target;
+        if (d.kind == plan_op_kind::key)
+            ops[i].key.assign(names + field_names[d.field], def.fields[d.field].name.size());
+        ops[i].type = link(d.type);
+    }
+    for (uint32_t i = 0; i < def.type_index.size(); ++i) {
+        auto& [name, type] = def.type_index[i];
+        index[i].name.assign(names + index_names[i], name.size());
+        index[i].type = link(type);
+        auto slot = type_name_hash(name, 0) & (num_slots - 1);
+        while (slots[slot])
+            slot = (slot + 1) & (num_slots - 1);
+        slots[slot] = i + 1;
+    }
+    for (size_t i = 0; i < def.actions.size(); ++i) {
+        actions[i].action = def.actions[i].first;
+        actions[i].type.assign(names + action_names[i], def.actions[i].second.size());
+    }
+
+    image->layout = contract_image_layout;
+    image->size = size;
+    image->types.assign(types, def.types.size());
+    image->plan_ops.assign(ops, op_defs.size());
+    image->type_index.assign(index, def.type_index.size());
+    image->type_slots.assign(slots, num_slots);
+    image->fields.assign(fields, def.fields.size());
+    image->actions.assign(actions, def.actions.size());
+    image->names.assign(names, name_bytes);
+    c.image = image;
+    return c;
+}
+
+// Checks an image read from a registry file before it's used in place. Every link must stay within the image, and
+// every plan must have the shape plan_conversions gives it, so that conversions neither leave the image nor unbalance
+// their stacks. Returns null if a build with a different layout wrote the image; throws if it's corrupt.
+inline const contract_image* check_contract_image(std::string_view bytes) {
+    auto corrupt = [] { return std::runtime_error("contract image is corrupt"); };
+    auto* data = bytes.data();
+    if (bytes.size() < sizeof(contract_image) || reinterpret_cast<uintptr_t>(data) % alignof(contract_image))
+        throw corrupt();
+    auto* image = reinterpret_cast<const contract_image*>(data);
+    if (image->layout != contract_image_layout)
+        return nullptr;
+    if (image->size != bytes.size())
+        throw corrupt();
+
+    auto target = [&](const auto& link) { return reinterpret_cast<const char*>(&link) - data + link.offset; };
+    auto check_array = [&](const auto& array, size_t align, size_t element_size) {
+        if (!array.count) {
+            if (array.first.offset)
+                throw corrupt();
+            return;
+        }
+        auto begin = target(array.first);
+        if (begin < 0 || begin % align || uint64_t(begin) > bytes.size() ||
+            array.count > (bytes.size() - begin) / element_size)
+            throw corrupt();
+    };
+    check_array(image->types, alignof(abi_type), sizeof(abi_type));
+    check_array(image->plan_ops, alignof(plan_op), sizeof(plan_op));
+    check_array(image->type_index, alignof(type_index_entry), sizeof(type_index_entry));
+    check_array(image->type_slots, alignof(uint32_t), sizeof(uint32_t));
+    check_array(image->fields, alignof(abi_field), sizeof(abi_field));
+    check_array(image->actions, alignof(action_type_entry), sizeof(action_type_entry));
+    check_array(image->names, 1, 1);
+
+    // The position in array of the element which link points to
+    auto index_in = [&](const auto& link, const auto& array) -> size_t {
+        auto element_size = sizeof(*array.begin());
+        auto offset = target(link) - (reinterpret_cast<const char*>(array.begin()) - data);
+        if (!link.offset || array.empty() || offset < 0 || offset % element_size ||
+            size_t(offset) / element_size >= array.size())
+            throw corrupt();
+        return offset / element_size;
+    };
+    auto check_name = [&](const rel_string& s) {
+        if (!s.count) {
+            if (s.first.offset)
+                throw corrupt();
+            return;
+        }
+        if (index_in(s.first, image->names) + s.count > image->names.size())
+            throw corrupt();
+    };
+    auto& types = image->types;
+    auto& ops = image->plan_ops;
+    for (auto& t : types) {
+        check_name(t.name);
+        if (t.kind > abi_type_kind::invalid || (t.kind == abi_type_kind::value && t.converter >= abi_converters.size()))
+            throw corrupt();
+        if (t.optional_of)
+            index_in(t.optional_of, types);
+        if (t.array_of)
+            index_in(t.array_of, types);
+        if (!t.fields.empty() && index_in(t.fields.first, image->fields) + t.fields.size() > image->fields.size())
+            throw corrupt();
+        if (t.fields.empty() && t.fields.first.offset)
+            throw corrupt();
+        index_in(t.plan, ops);
+    }
+    for (auto& f : image->fields) {
+        check_name(f.name);
+        index_in(f.type, types);
+    }
+    for (auto& entry : image->type_index) {
+        check_name(entry.name);
+        index_in(entry.type, types);
+    }
+    auto& slots = image->type_slots;
+    if (slots.empty() || (slots.size() & (slots.size() - 1)) ||
+        std::find(slots.begin(), slots.end(), 0u) == slots.end())
+        throw corrupt();
+    for (auto slot : slots)
+        if (slot > image->type_index.size())
+            throw corrupt();
+    for (size_t i = 0; i < image->actions.size(); ++i) {
+        check_name(image->actions[i].type);
+        if (i && !(image->actions[i - 1].action < image->actions[i].action))
+            throw corrupt();
+    }
+
+    // Each value is optional flags, then one value, name, object, array or invalid op. Object and array ops enter the
+    // body of their type, which is checked once.
+    hooked_vector<uint32_t> body_types(ops.size(), contract_def::none);
+    hooked_vector<size_t> bodies; // the first op to enter each
+    auto jump = [&](size_t op) {
+        auto to = int64_t(op) + ops[op].target;
+        if (to < 0 || uint64_t(to) >= ops.size())
+            throw corrupt();
+        return size_t(to);
+    };
+    auto check_value = [&](size_t& op) {
+        auto first = op;
+        while (op < ops.size() && ops[op].kind == plan_op_kind::optional)
+            ++op;
+        if (op >= ops.size())
+            throw corrupt();
+        auto& value = ops[op];
+        if (value.kind == plan_op_kind::object || value.kind == plan_op_kind::array) {
+            auto type = index_in(value.type, types);
+            auto body = jump(op);
+            if (types[type].kind != (value.kind == plan_op_kind::object ? abi_type_kind::object : abi_type_kind::array))
+                throw corrupt();
+            if (body_types[body] == contract_def::none) {
+                body_types[body] = type;
+                bodies.push_back(op);
+            } else if (body_types[body] != type)
+                throw corrupt();
+        } else if (value.kind == plan_op_kind::value) {
+            if (value.converter >= abi_converters.size())
+                throw corrupt();
+        } else if (value.kind != plan_op_kind::name && value.kind != plan_op_kind::invalid)
+            throw corrupt();
+        ++op;
+        for (auto i = first; i + 1 < op; ++i)
+            if (jump(i) != op)
+                throw corrupt();
+    };
+    auto expect = [&](size_t op, plan_op_kind kind) {
+        if (op >= ops.size() || ops[op].kind != kind)
+            throw corrupt();
+    };
+    for (auto& t : types) {
+        auto op = index_in(t.plan, ops);
+        check_value(op);
+        expect(op, plan_op_kind::done);
+    }
+    for (size_t i = 0; i < bodies.size(); ++i) { // checking a body may add bodies
+        auto caller = bodies[i];
+        auto start = jump(caller);
+        auto op = start;
+        if (ops[caller].kind == plan_op_kind::object) {
+            auto& type = *ops[caller].type;
+            for (size_t j = 0; j < type.fields.size(); ++j) {
+                expect(op, plan_op_kind::key);
+                if (ops[op].target != int32_t(j))
+                    throw corrupt();
+                check_name(ops[op].key);
+                check_value(++op);
+            }
+            expect(op, plan_op_kind::end_object);
+        } else {
+            expect(op, plan_op_kind::item);
+            check_value(++op);
+            expect(op, plan_op_kind::next_item);
+            if (jump(op) != start)
+                throw corrupt();
+        }
+    }
+    return image;
+}
+
+struct builtin_type_slots {
+    static constexpr size_t size = 128;
+    uint32_t seed = 0;
+    std::array<int8_t, size> slots{}; // index into builtin_type_names, or -1
+
+    // The top bits; FNV's low bits barely depend on the seed
+    static constexpr size_t slot(std::string_view name, uint32_t seed) { return type_name_hash(name, seed) >> 25; }
+};
+static_assert(builtin_type_slots::size == 1 << (32 - 25));
+
+// Finds the first seed which maps every builtin name to its own slot
+constexpr builtin_type_slots make_builtin_type_slots() {
+    for (uint32_t seed = 0;; ++seed) {
+        builtin_type_slots result{seed, {}};
+        for (auto& slot : result.slots)
+            slot = -1;
+        bool collided = false;
+        for (size_t i = 0; i < builtin_type_names.size() && !collided; ++i) {
+            auto& slot = result.slots[builtin_type_slots::slot(builtin_type_names[i], seed)];
+            collided = slot >= 0;
+            slot = int8_t(i);
+        }
+        if (!collided)
+            return result;
+    }
+}
+
+inline constexpr auto builtin_type_slots_for_names = make_builtin_type_slots();
+
+struct builtin_type_table {
+    contract types{}; // T, T[], T? of builtin_type_names[i] at 3i
+
+    builtin_type_table() {
+        allocator_scope scope{nullptr}; // the table outlives every context
+        std::string derived_names;
+        size_t size = 0;
+        for (auto name : builtin_type_names)
+            size += name.size() * 2 + 3;
+        derived_names.reserve(size); // so names don't move
+        auto derive = [&](std::string_view name, const char* suffix) {
+            auto begin = derived_names.size();
+            derived_names.append(name.data(), name.size()).append(suffix);
+            return std::string_view{derived_names}.substr(begin);
+        };
+        auto position = [](std::string_view name) {
+            return uint32_t(std::find(builtin_type_names.begin(), builtin_type_names.end(), name) -
+                            builtin_type_names.begin());
+        };
+
+        contract_def def;
+        for (uint32_t i = 0; i < builtin_type_names.size(); ++i) {
+            auto name = builtin_type_names[i];
+            auto& type = def.types.emplace_back();
+            type.name = name;
+            if (i < abi_converters.size()) {
+                type.kind = abi_type_kind::value;
+                type.converter = i;
+            } else {
+                type.kind = abi_type_kind::object; // extended_asset
+                def.fields.push_back({"quantity", position("asset") * 3});
+                def.fields.push_back({"contract", position("name") * 3});
+                type.end_field = def.fields.size();
+            }
+            auto& array = def.types.emplace_back();
+            array.name = derive(name, "[]");
+            array.kind = abi_type_kind::array;
+            array.array_of = i * 3;
+            auto& optional = def.types.emplace_back();
+            optional.name = derive(name, "?");
+            optional.kind = abi_type_kind::optional;
+            optional.optional_of = i * 3;
+        }
+        types = lay_out_contract(def);
+    }
+
+    builtin_type_table(const builtin_type_table&) = delete;
+
+    // Finds a builtin type, or T[] or T? of one
+    const abi_type* find(std::string_view name) const {
+        size_t kind = 0;
+        if (ends_with(name, "[]"))
+            name.remove_suffix(2), kind = 1;
+        else if (ends_with(name, "?"))
+            name.remove_suffix(1), kind = 2;
+        auto& slots = builtin_type_slots_for_names;
+        auto i = slots.slots[builtin_type_slots::slot(name, slots.seed)];
+        if (i < 0 || builtin_type_names[i] != name)
+            return nullptr;
+        return &types.image->types[i * 3 + kind];
+    }
+};
+
+inline const builtin_type_table& builtin_types() {
+    static const builtin_type_table table;
+    return table;
+}
+
+// A type while create_contract builds a contract. Builtins the abi refers to get entries which point to the shared
+// builtin table; freeze_contract copies the builtins they need into the contract, since an image only links within
+// itself.
+struct abi_type_builder {
+    hooked_string name{};
+    std::string_view alias_of_name{};
+    const struct_def_view* struct_def{};
+    const abi_type* builtin{};
+    abi_type_builder* alias_of{};
+    abi_type_builder* optional_of{};
+    abi_type_builder* array_of{};
+    abi_type_kind kind = abi_type_kind::invalid;
+    bool filled_struct{};
+    size_t begin_field{}; // into the fields being laid out
+    size_t end_field{};
+    uint32_t index{}; // into contract_def::types
+
+    bool is_derived() const {
+        return optional_of || array_of || (builtin && (builtin->optional_of || builtin->array_of));
+    }
+};
+
+struct field_builder {
+    std::string_view name{};
+    abi_type_builder* type{};
+};
+
+using abi_type_map = hooked_map<hooked_string, abi_type_builder, string_less>;
+
+inline abi_type_builder& get_type(abi_type_map& abi_types, std::string_view name, int depth) {
+    if (depth >= 32)
+        throw std::runtime_error("abi recursion limit reached");
+    auto it = abi_types.find(name);
+    if (it == abi_types.end()) {
+        if (auto* builtin = builtin_types().find(name)) {
+            abi_type_builder type{hooked_string{name}};
+            type.builtin = builtin;
+            auto key = type.name;
+            return abi_types.try_emplace(std::move(key), std::move(type)).first->second;
+        } else if (ends_with(name, "?")) {
+            abi_type_builder type{hooked_string{name}};
+            type.optional_of = &get_type(abi_types, name.substr(0, name.size() - 1), depth + 1);
+            if (type.optional_of->is_derived())
+                throw std::runtime_error("optional and array don't support nesting");
+            type.kind = abi_type_kind::optional;
+            auto key = type.name;
+            return abi_types.try_emplace(std::move(key), std::move(type)).first->second;
+        } else if (ends_with(name, "[]")) {
+            abi_type_builder type{hooked_string{name}};
+            type.array_of = &get_type(abi_types, name.substr(0, name.size() - 2), depth + 1);
+            if (type.array_of->is_derived())
+                throw std::runtime_error("optional and array don't support nesting");
+            type.kind = abi_type_kind::array;
+            auto key = type.name;
+            return abi_types.try_emplace(std::move(key), std::move(type)).first->second;
+        } else
+            throw std::runtime_error("unknown type \"" + std::string{name} + "\"");
+    }
+    if (it->second.alias_of)
+        return *it->second.alias_of;
+    if (it->second.alias_of_name.empty())
+        return it->second;
+    auto& other = get_type(abi_types, it->second.alias_of_name, depth + 1);
+    it->second.alias_of = &other;
+    return other;
+}
+
+// Lays out the fields of every struct, visiting each struct's bases before it, without recursion. A struct whose
+// base's fields are the last laid out extends them in place, so an inheritance chain of any depth shares one run of
+// fields; otherwise it copies them.
+inline void lay_out_structs(const abi_view& abi, abi_type_map& abi_types, hooked_vector<field_builder>& fields) {
+    enum : uint8_t { unvisited, visiting, laid_out };
+    hooked_vector<abi_type_builder*> structs(abi.structs.size());
+    hooked_vector<uint8_t> states(abi.structs.size(), unvisited);
+    hooked_vector<size_t> chain;
+    for (size_t i = 0; i < abi.structs.size(); ++i)
+        structs[i] = &get_type(abi_types, abi.structs[i].name, 0);
+
+    // extended_asset is the only builtin struct; structs derived from it copy its fields from here
+    abi_type_builder extended_asset;
+    auto* builtin_extended_asset = builtin_types().find("extended_asset");
+
+    auto lay_out = [&](size_t i, const abi_type_builder* base) {
+        auto& s = abi.structs[i];
+        auto& type = *structs[i];
+        type.begin_field = fields.size();
+        if (base && base->end_field == fields.size())
+            type.begin_field = base->begin_field;
+        else if (base)
+            for (auto j = base->begin_field; j < base->end_field; ++j) {
+                auto field = fields[j];
+                fields.push_back(field);
+            }
+        for (auto j = s.begin_field; j < s.end_field; ++j)
+            fields.push_back({abi.fields[j].name, &get_type(abi_types, abi.fields[j].type, 0)});
+        type.end_field = fields.size();
         type.filled_struct = true;
-        type.ser = &abi_serializer_for<pseudo_object>;
-        c.abi_types.insert({"extended_asset", std::move(type)});
+        states[i] = laid_out;
+    };
+
+    for (size_t i = 0; i < abi.structs.size(); ++i) {
+        // Walk up from struct i to the first base which is laid out, or the root, then lay out back down
+        const abi_type_builder* base = nullptr;
+        for (auto j = i; states[j] == unvisited;) {
+            states[j] = visiting;
+            chain.push_back(j);
+            if (abi.structs[j].base.empty())
+                break;
+            auto& b = get_type(abi_types, abi.structs[j].base, 0);
+            if (b.builtin == builtin_extended_asset) {
+                if (!extended_asset.filled_struct) {
+                    extended_asset.begin_field = fields.size();
+                    for (auto& field : builtin_extended_asset->fields)
+                        fields.push_back({field.name, &get_type(abi_types, field.type->name, 0)});
+                    extended_asset.end_field = fields.size();
+                    extended_asset.filled_struct = true;
+                }
+                base = &extended_asset;
+                break;
+            }
+            if (!b.struct_def)
+                throw std::runtime_error("abi type \"" + std::string{b.name} + "\" is not a struct");
+            j = b.struct_def - abi.structs.data();
+            if (states[j] == visiting)
+                throw std::runtime_error("abi recursion limit reached");
+            if (states[j] == laid_out)
+                base = structs[j];
+        }
+        for (; !chain.empty(); chain.pop_back()) {
+            lay_out(chain.back(), base);
+            base = structs[chain.back()];
+        }
     }
+}
+
+// Copies the built types into a contract_def, along with the builtins they refer to, and lays it out
+inline contract freeze_contract(abi_type_map& abi_types, const hooked_vector<field_builder>& fields,
+                                const hooked_map<name, std::string_view>& actions) {
+    contract_def def;
+    uint32_t num_types = 0;
+    for (auto& [name, t] : abi_types)
+        if (!t.builtin && !t.alias_of)
+            t.index = num_types++;
+    def.types.resize(num_types);
+
+    auto& table = builtin_types().types.image->types;
+    hooked_vector<uint32_t> builtins(table.size(), contract_def::none); // where each is copied into def.types
+    auto copy_builtin = [&](const abi_type* type, auto& copy_builtin) -> uint32_t {
+        auto& copy = builtins[type - table.begin()];
+        if (copy != contract_def::none)
+            return copy;
+        uint32_t index = copy = def.types.size();
+        def.types.push_back({type->name, type->kind, type->converter});
+        if (type->optional_of)
+            def.types[index].optional_of = copy_builtin(type->optional_of, copy_builtin);
+        if (type->array_of)
+            def.types[index].array_of = copy_builtin(type->array_of, copy_builtin);
+        if (!type->fields.empty()) {
+            hooked_vector<contract_def::field> copied;
+            for (auto& field : type->fields)
+                copied.push_back({field.name, copy_builtin(field.type, copy_builtin)});
+            def.types[index].begin_field = def.fields.size();
+            def.fields.insert(def.fields.end(), copied.begin(), copied.end());
+            def.types[index].end_field = def.fields.size();
+        }
+        return index;
+    };
+    auto compiled = [&](const abi_type_builder* t) -> uint32_t {
+        if (!t)
+            return contract_def::none;
+        return t->builtin ? copy_builtin(t->builtin, copy_builtin) : t->index;
+    };
 
+    // Structs' fields come first, at the positions lay_out_structs gave them; copied builtins' follow
+    def.fields.resize(fields.size());
+    for (size_t i = 0; i < fields.size(); ++i)
+        def.fields[i] = {fields[i].name, compiled(fields[i].type)};
+    def.type_index.reserve(abi_types.size());
+    for (auto& [name, t] : abi_types) {
+        if (t.builtin)
+            continue;
+        def.type_index.push_back({name, compiled(t.alias_of ? t.alias_of : &t)});
+        if (t.alias_of)
+            continue;
+        auto optional_of = compiled(t.optional_of);
+        auto array_of = compiled(t.array_of);
+        auto& type = def.types[t.index];
+        type.name = name;
+        type.kind = t.kind;
+        type.optional_of = optional_of;
+        type.array_of = array_of;
+        type.begin_field = t.begin_field;
+        type.end_field = t.end_field;
+    }
+    def.actions.assign(actions.begin(), actions.end());
+    return lay_out_contract(def);
+}
+
+inline contract create_contract(const abi_view& abi) {
+    abi_type_map abi_types;
     for (auto& t : abi.types) {
         if (t.new_type_name.empty())
             throw std::runtime_error("abi has a type with a missing name");
-        auto [_, inserted] = c.abi_types.insert({t.new_type_name, abi_type{t.new_type_name, t.type}});
+        if (builtin_types().find(t.new_type_name))
+            throw std::runtime_error("abi redefines type \"" + std::string{t.new_type_name} + "\"");
+        abi_type_builder type{hooked_string{t.new_type_name}};
+        type.alias_of_name = t.type;
+        auto [_, inserted] = abi_types.try_emplace(hooked_string{t.new_type_name}, std::move(type));
         if (!inserted)
-            throw std::runtime_error("abi redefines type \"" + t.new_type_name + "\"");
+            throw std::runtime_error("abi redefines type \"" + std::string{t.new_type_name} + "\"");
     }
     for (auto& s : abi.structs) {
         if (s.name.empty())
             throw std::runtime_error("abi has a struct with a missing name");
-        abi_type type{s.name};
+        if (builtin_types().find(s.name))
+            throw std::runtime_error("abi redefines type \"" + std::string{s.name} + "\"");
+        abi_type_builder type{hooked_string{s.name}};
         type.struct_def = &s;
-        type.ser = &abi_serializer_for<pseudo_object>;
-        auto [_, inserted] = c.abi_types.insert({s.name, std::move(type)});
+        type.kind = abi_type_kind::object;
+        auto [_, inserted] = abi_types.try_emplace(hooked_string{s.name}, std::move(type));
         if (!inserted)
-            throw std::runtime_error("abi redefines type \"" + s.name + "\"");
+            throw std::runtime_error("abi redefines type \"" + std::string{s.name} + "\"");
     }
-    for (auto& [_, t] : c.abi_types)
+    for (auto& [_, t] : abi_types)
         if (!t.alias_of_name.empty())
-            t.alias_of = &get_type(c.abi_types, t.alias_of_name, 0);
-    for (auto& [_, t] : c.abi_types)
-        if (t.struct_def)
-            fill_struct(c.abi_types, t, 0);
-    for (auto& [_, t] : c.abi_types)
-        t.struct_def = nullptr;
-    return c;
+            t.alias_of = &get_type(abi_types, t.alias_of_name, 0);
+    hooked_vector<field_builder> fields;
+    lay_out_structs(abi, abi_types, fields);
+
+    // Create every T[] and T? now, so the contract never changes after this and conversions may share it freely.
+    // Builtins have theirs already.
+    hooked_vector<std::string_view> names;
+    for (auto& [name, t] : abi_types)
+        if (!t.array_of && !t.optional_of && !t.builtin)
+            names.push_back(name);
+    for (auto name : names) {
+        if (get_type(abi_types, name, 0).is_derived())
+            continue;
+        hooked_string derived{name};
+        derived += "[]";
+        get_type(abi_types, derived, 0);
+        derived.resize(name.size());
+        derived += '?';
+        get_type(abi_types, derived, 0);
+    }
+
+    hooked_map<name, std::string_view> actions;
+    for (auto& a : abi.actions)
+        actions[a.name] = a.type;
+    return freeze_contract(abi_types, fields, actions);
+}
+
+// Finds the errors create_contract would report for missing names, redefined types and references to unknown types,
+// without compiling anything. Alias cycles and recursion are left to create_contract.
+inline void check_abi(const abi_view& abi) {
+    hooked_vector<std::string_view> names{builtin_type_names.begin(), builtin_type_names.end()};
+    for (auto& t : abi.types) {
+        if (t.new_type_name.empty())
+            throw std::runtime_error("abi has a type with a missing name");
+        names.push_back(t.new_type_name);
+    }
+    for (auto& s : abi.structs) {
+        if (s.name.empty())
+            throw std::runtime_error("abi has a struct with a missing name");
+        names.push_back(s.name);
+    }
+    std::sort(names.begin(), names.end());
+    auto redefined = std::adjacent_find(names.begin(), names.end());
+    if (redefined != names.end())
+        throw std::runtime_error("abi redefines type \"" + std::string{*redefined} + "\"");
+
+    auto check_type = [&](std::string_view type) {
+        if (ends_with(type, "?"))
+            type.remove_suffix(1);
+        else if (ends_with(type, "[]"))
+            type.remove_suffix(2);
+        if (ends_with(type, "?") || ends_with(type, "[]"))
+            throw std::runtime_error("optional and array don't support nesting");
+        if (!std::binary_search(names.begin(), names.end(), type))
+            throw std::runtime_error("unknown type \"" + std::string{type} + "\"");
+    };
+    for (auto& t : abi.types)
+        check_type(t.type);
+    for (auto& s : abi.structs)
+        if (!s.base.empty())
+            check_type(s.base);
+    for (auto& field : abi.fields)
+        check_type(field.type);
+}
+
+inline contract create_contract(const abi_def& abi) { return create_contract(make_abi_view(abi)); }
+inline void check_abi(const abi_def& abi) { check_abi(make_abi_view(abi)); }
+
+// Looks up a type in a compiled contract, then in the builtin types
+// Doesn't modify the contract or allocate, so any number of threads may look up types at once
+inline const abi_type* find_type(const contract& c, std::string_view name) {
+    auto& slots = c.image->type_slots;
+    auto mask = slots.size() - 1;
+    for (auto slot = type_name_hash(name, 0) & mask; slots[slot]; slot = (slot + 1) & mask) {
+        auto& entry = c.image->type_index[slots[slot] - 1];
+        if (entry.name == name)
+            return entry.type;
+    }
+    return builtin_types().find(name);
+}
+
+// The type of an action's data, if the contract has the action
+inline const rel_string* find_action_type(const contract& c, name action) {
+    auto& actions = c.image->actions;
+    auto it = std::lower_bound(actions.begin(), actions.end(), action,
+                               [](const action_type_entry& entry, name action) { return entry.action < action; });
+    return it != actions.end() && it->action.value == action.value ? &it->type : nullptr;
+}
+
+inline const abi_type& get_type(const contract& c, std::string_view name) {
+    auto* type = find_type(c, name);
+    if (!type) {
+        if ((ends_with(name, "[]") && find_type(c, name.substr(0, name.size() - 2))) ||
+            (ends_with(name, "?") && find_type(c, name.substr(0, name.size() - 1))))
+            throw std::runtime_error("optional and array don't support nesting");
+        throw std::runtime_error("unknown type \"" + std::string{name} + "\"");
+    }
+    return *type;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // json_to_bin
 ///////////////////////////////////////////////////////////////////////////////
 
+// Steps through the plan to the op which consumes event, and past it
 inline bool receive_event(struct json_to_bin_state& state, event_type event, bool start) {
-    if (state.stack.empty())
-        return false;
     if (trace_json_to_bin_event)
         printf("(event %d %d)\n", (int)event, start);
-    auto* type = state.stack.back().type;
     if (start)
         state.stack.clear();
-    if (state.stack.size() > max_stack_size)
-        throw std::runtime_error("recursion limit reached");
-    return type->ser && type->ser->json_to_bin(state, type, event, start);
+    for (auto*& op = state.op;;) {
+        switch (op->kind) {
+        case plan_op_kind::value:
+            if (event == event_type::received_string)
+                state.received_data.value_string.assign(state.received_string.data(), state.received_string.size());
+            if (!abi_converters[op->converter].json_to_bin(state, event))
+                return false;
+            ++op;
+            return true;
+        case plan_op_kind::name:
+            if (event != event_type::received_string)
+                return report_error(state, "expected string containing name");
+            push_raw(state.bin, string_to_name(state.received_string.data()));
+            ++op;
+            return true;
+        case plan_op_kind::optional:
+            if (event == event_type::received_null) {
+                state.bin.push_back(0);
+                op += op->target;
+                return true;
+            }
+            state.bin.push_back(1);
+            ++op; // the value follows, starting with this event
+            break;
+        case plan_op_kind::object:
+            if (event != event_type::received_start_object)
+                return report_error(state, "expected object");
+            if (trace_json_to_bin)
+                printf("%*s{ %d fields\n", int(state.stack.size() * 4), "", int(op->type->fields.size()));
+            state.stack.push_back({op->type, -1, 0, op});
+            if (state.stack.size() > max_stack_size)
+                return report_error(state, "recursion limit reached");
+            op += op->target;
+            return true;
+        case plan_op_kind::key:
+            if (event == event_type::received_key) {
+                state.stack.back().position = op->target;
+                if (state.received_string == op->key) {
+                    ++op;
+                    return true;
+                }
+            }
+            return report_error(state, "expected field \"", op->key, "\"");
+        case plan_op_kind::end_object: {
+            auto& entry = state.stack.back();
+            if (event != event_type::received_end_object) {
+                entry.position = entry.type->fields.size();
+                return report_error(state, "unexpected field \"", state.received_string, "\"");
+            }
+            if (trace_json_to_bin)
+                printf("%*s}\n", int((state.stack.size() - 1) * 4), "");
+            op = entry.caller + 1;
+            state.stack.pop_back();
+            return true;
+        }
+        case plan_op_kind::array:
+            if (event != event_type::received_start_array)
+                return report_error(state, "expected array");
+            if (trace_json_to_bin)
+                printf("%*s[\n", int(state.stack.size() * 4), "");
+            state.stack.push_back({op->type, -1, state.size_insertions.size(), op});
+            state.size_insertions.push_back({state.bin.size()});
+            if (state.stack.size() > max_stack_size)
+                return report_error(state, "recursion limit reached");
+            op += op->target;
+            return true;
+        case plan_op_kind::item: {
+            auto& entry = state.stack.back();
+            if (event == event_type::received_end_array) {
+                if (trace_json_to_bin)
+                    printf("%*s]\n", int((state.stack.size() - 1) * 4), "");
+                state.size_insertions[entry.size_insertion_index].size = entry.position + 1;
+                op = entry.caller + 1;
+                state.stack.pop_back();
+                return true;
+            }
+            ++entry.position;
+            ++op; // the item follows, starting with this event
+            break;
+        }
+        case plan_op_kind::next_item:
+            op += op->target;
+            break;
+        case plan_op_kind::done:
+        case plan_op_kind::invalid:
+            return false;
+        }
+    }
 }
 
-inline bool json_to_bin(std::vector<char>& bin, const abi_type* type, std::string_view json) {
-    std::string mutable_json{json};
-    json_to_bin_state state;
+// Describes where in the value the parser stopped, e.g. "transfer.quantity: "
+template <typename String>
+void append_error_path(String& s, const json_to_bin_state& state) {
+    if (!state.stack.empty() && state.stack[0].type->is_struct())
+        s += state.stack[0].type->name;
+    for (auto& entry : state.stack) {
+        if (entry.type->array_of) {
+            char pos[16];
+            s += '[';
+            s.append(pos, std::to_chars(pos, pos + sizeof(pos), entry.position).ptr);
+            s += ']';
+        } else if (entry.type->is_struct()) {
+            if (entry.position >= 0 && entry.position < (int)entry.type->fields.size()) {
+                s += '.';
+                s += entry.type->fields[entry.position].name;
+            }
+        } else
+            s += "<?>";
+    }
+    if (!s.empty())
+        s += ": ";
+}
+
+// Parses a single value into state; use get_bin_size() and write_bin() to retrieve the result. state and mutable_json
+// may hold capacity from a previous conversion; they're reset before use. Returns false, with the reason in
+// state.error, if json is malformed or doesn't match type.
+inline bool json_to_bin(json_to_bin_state& state, hooked_string& mutable_json, const abi_type* type,
+                        std::string_view json) {
+    mutable_json.assign(json.data(), json.size());
+    state.started = false;
+    state.error.clear();
+    state.bin.clear();
+    state.size_insertions.clear();
+    state.stack.clear();
     state.stack.push_back({type});
-    rapidjson::Reader reader;
+    state.op = type->plan;
     rapidjson::InsituStringStream ss(mutable_json.data());
     try {
-        if (!reader.Parse<rapidjson::kParseValidateEncodingFlag | rapidjson::kParseIterativeFlag |
-                          rapidjson::kParseNumbersAsStringsFlag>(ss, state))
-            throw std::runtime_error{"failed to parse"};
+        if (state.reader.Parse<rapidjson::kParseValidateEncodingFlag | rapidjson::kParseIterativeFlag |
+                               rapidjson::kParseNumbersAsStringsFlag>(ss, state))
+            return true;
     } catch (std::exception& e) {
         std::string s;
-        if (!state.stack.empty() && state.stack[0].type->filled_struct)
-            s += state.stack[0].type->name;
-        for (auto& entry : state.stack) {
-            if (entry.type->array_of)
-                s += "[" + std::to_string(entry.position) + "]";
-            else if (entry.type->filled_struct) {
-                if (entry.position >= 0 && entry.position < (int)entry.type->fields.size())
-                    s += "." + entry.type->fields[entry.position].name;
-            } else
-                s += "<?>";
-        }
-        if (!s.empty())
-            s += ": ";
+        append_error_path(s, state);
         s += e.what();
         throw std::runtime_error{s};
     }
+    auto reason = state.error.empty() ? std::string_view{"failed to parse"} : std::string_view{state.error};
+    arena_string s;
+    append_error_path(s, state);
+    s += reason;
+    state.error.assign(s.data(), s.size());
+    return false;
+}
+
+// Size of the binary produced by a successful parse
+inline size_t get_bin_size(const json_to_bin_state& state) {
+    size_t size = state.bin.size();
+    for (auto& insertion : state.size_insertions)
+        size += varuint32_size(insertion.size);
+    return size;
+}
+
+// Writes get_bin_size(state) bytes to dest, splicing the array sizes into place
+inline void write_bin(const json_to_bin_state& state, char* dest) {
     size_t pos = 0;
     for (auto& insertion : state.size_insertions) {
-        bin.insert(bin.end(), state.bin.begin() + pos, state.bin.begin() + insertion.position);
-        push_varuint32(bin, insertion.size);
+        dest = std::copy(state.bin.begin() + pos, state.bin.begin() + insertion.position, dest);
+        dest = write_varuint32(dest, insertion.size);
         pos = insertion.position;
     }
-    bin.insert(bin.end(), state.bin.begin() + pos, state.bin.end());
-    return true;
-}
-
-inline bool json_to_bin(pseudo_optional*, json_to_bin_state& state, const abi_type* type, event_type event, bool) {
-    if (event == event_type::received_null) {
-        state.bin.push_back(0);
-        return true;
-    }
-    state.bin.push_back(1);
-    return type->optional_of->ser && type->optional_of->ser->json_to_bin(state, type->optional_of, event, true);
+    std::copy(state.bin.begin() + pos, state.bin.end(), dest);
 }
 
-inline bool json_to_bin(pseudo_object*, json_to_bin_state& state, const abi_type* type, event_type event, bool start) {
-    if (start) {
-        if (event != event_type::received_start_object)
-            throw std::runtime_error("expected object");
-        if (trace_json_to_bin)
-            printf("%*s{ %d fields\n", int(state.stack.size() * 4), "", int(type->fields.size()));
-        state.stack.push_back({type});
-        return true;
-    }
-    auto& stack_entry = state.stack.back();
-    if (event == event_type::received_end_object) {
-        if (stack_entry.position + 1 != (ptrdiff_t)type->fields.size())
-            throw std::runtime_error("expected field \"" + type->fields[stack_entry.position + 1].name + "\"");
-        if (trace_json_to_bin)
-            printf("%*s}\n", int((state.stack.size() - 1) * 4), "");
-        state.stack.pop_back();
-        return true;
-    }
-    if (event == event_type::received_key) {
-        if (++stack_entry.position >= (ptrdiff_t)type->fields.size())
-            throw std::runtime_error("unexpected field \"" + state.received_data.key + "\"");
-        auto& field = type->fields[stack_entry.position];
-        if (state.received_data.key != field.name)
-            throw std::runtime_error("expected field \"" + field.name + "\"");
-        return true;
-    } else {
-        auto& field = type->fields[stack_entry.position];
-        if (trace_json_to_bin)
-            printf("%*sfield %d/%d: %s (event %d)\n", int(state.stack.size() * 4), "", int(stack_entry.position),
-                   int(type->fields.size()), std::string{field.name}.c_str(), (int)event);
-        return field.type->ser && field.type->ser->json_to_bin(state, field.type, event, true);
-    }
+// Converts a single value and appends the result to bin. state and mutable_json may hold capacity from a previous
+// conversion; they're reset before use.
+inline bool json_to_bin(hooked_vector<char>& bin, json_to_bin_state& state, hooked_string& mutable_json,
+                        const abi_type* type, std::string_view json) {
+    if (!json_to_bin(state, mutable_json, type, json))
+        return false;
+    auto pos = bin.size();
+    bin.resize(pos + get_bin_size(state));
+    write_bin(state, bin.data() + pos);
+    return true;
 }
 
-inline bool json_to_bin(pseudo_array*, json_to_bin_state& state, const abi_type* type, event_type event, bool start) {
-    if (start) {
-        if (event != event_type::received_start_array)
-            throw std::runtime_error("expected array");
-        if (trace_json_to_bin)
-            printf("%*s[\n", int(state.stack.size() * 4), "");
-        state.stack.push_back({type});
-        state.stack.back().size_insertion_index = state.size_insertions.size();
-        state.size_insertions.push_back({state.bin.size()});
-        return true;
-    }
-    auto& stack_entry = state.stack.back();
-    if (event == event_type::received_end_array) {
-        if (trace_json_to_bin)
-            printf("%*s]\n", int((state.stack.size() - 1) * 4), "");
-        state.size_insertions[stack_entry.size_insertion_index].size = stack_entry.position + 1;
-        state.stack.pop_back();
-        return true;
-    }
-    ++stack_entry.position;
-    if (trace_json_to_bin)
-        printf("%*sitem (event %d)\n", int(state.stack.size() * 4), "", (int)event);
-    return type->array_of->ser && type->array_of->ser->json_to_bin(state, type->array_of, event, true);
+inline bool json_to_bin(hooked_vector<char>& bin, const abi_type* type, std::string_view json) {
+    hooked_string mutable_json;
+    json_to_bin_state state;
+    return json_to_bin(bin, state, mutable_json, type, json);
 }
 
 template <typename T>
 auto json_to_bin(T*, json_to_bin_state& state, const abi_type*, event_type event, bool start)
     -> std::enable_if_t<std::is_arithmetic_v<T>, bool> {
-    push_raw(state.bin, json_to_number<T>(state, event));
+    T v;
+    if (!json_to_number(v, state, event))
+        return false;
+    push_raw(state.bin, v);
     return true;
 }
 
@@ -1620,109 +3195,145 @@ inline bool json_to_bin(std::string*, json_to_bin_state& state, const abi_type*,
         state.bin.insert(state.bin.end(), s.begin(), s.end());
         return true;
     } else
-        throw std::runtime_error("expected string");
+        return report_error(state, "expected string");
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // bin_to_json
 ///////////////////////////////////////////////////////////////////////////////
 
-inline bool bin_to_json(input_buffer& bin, const abi_type* type, std::string& dest) {
-    if (!type->ser)
-        return false;
-    rapidjson::StringBuffer buffer{};
-    rapidjson::Writer<rapidjson::StringBuffer> writer{buffer};
-    bin_to_json_state state{bin, writer};
-    if (!type->ser || !type->ser->bin_to_json(state, type, true))
-        return false;
-    while (!state.stack.empty()) {
-        if (!state.stack.back().type->ser ||
-            !state.stack.back().type->ser->bin_to_json(state, state.stack.back().type, false))
+// Converts a single value, leaving state.bin.pos just past it. state may hold capacity from a previous conversion; it's
+// reset before use. Returns false if bin is malformed; state.error holds the reason, or is empty if the json writer
+// rejected a value.
+inline bool bin_to_json(bin_to_json_state& state, input_buffer bin, const abi_type* type, output_stream& stream) {
+    state.bin = bin;
+    state.error.clear();
+    state.writer.Reset(stream);
+    state.stack.clear();
+    for (auto* op = type->plan.get();; ++op) {
+        switch (op->kind) {
+        case plan_op_kind::value:
+            if (!abi_converters[op->converter].bin_to_json(state))
+                return false;
+            break;
+        case plan_op_kind::name: {
+            uint64_t v;
+            char s[13];
+            if (!read_bin(state, v) || !state.writer.String(s, name_to_chars(v, s)))
+                return false;
+            break;
+        }
+        case plan_op_kind::optional: {
+            uint8_t present = 0;
+            if (!read_bin(state, present))
+                return false;
+            if (!present) {
+                if (!state.writer.Null())
+                    return false;
+                op += op->target - 1;
+            }
+            break;
+        }
+        case plan_op_kind::object:
+            if (trace_bin_to_json)
+                printf("%*s{ %d fields\n", int(state.stack.size() * 4), "", int(op->type->fields.size()));
+            state.stack.push_back({op});
+            if (state.stack.size() > max_stack_size)
+                return report_error(state, "recursion limit reached");
+            if (!state.writer.StartObject())
+                return false;
+            op += op->target - 1;
+            break;
+        case plan_op_kind::key:
+            if (trace_bin_to_json)
+                printf("%*sfield %.*s\n", int(state.stack.size() * 4), "", int(op->key.size()), op->key.data());
+            if (!state.writer.Key(op->key.data(), op->key.size()))
+                return false;
+            break;
+        case plan_op_kind::end_object:
+            if (trace_bin_to_json)
+                printf("%*s}\n", int((state.stack.size() - 1) * 4), "");
+            if (!state.writer.EndObject())
+                return false;
+            op = state.stack.back().caller;
+            state.stack.pop_back();
+            break;
+        case plan_op_kind::array: {
+            uint32_t size;
+            if (!read_varuint32(state, size))
+                return false;
+            if (trace_bin_to_json)
+                printf("%*s[ %u items\n", int(state.stack.size() * 4), "", size);
+            state.stack.push_back({op, size});
+            if (state.stack.size() > max_stack_size)
+                return report_error(state, "recursion limit reached");
+            if (!state.writer.StartArray())
+                return false;
+            op += op->target - 1;
+            break;
+        }
+        case plan_op_kind::item:
+            if (!state.stack.back().remaining_items) {
+                if (trace_bin_to_json)
+                    printf("%*s]\n", int((state.stack.size() - 1) * 4), "");
+                if (!state.writer.EndArray())
+                    return false;
+                op = state.stack.back().caller;
+                state.stack.pop_back();
+            } else
+                --state.stack.back().remaining_items;
+            break;
+        case plan_op_kind::next_item:
+            op += op->target - 1;
+            break;
+        case plan_op_kind::done:
+            return true;
+        case plan_op_kind::invalid:
             return false;
-        if (state.stack.size() > max_stack_size)
-            throw std::runtime_error("recursion limit reached");
+        }
     }
-    dest = buffer.GetString();
-    return true;
 }
 
-inline bool bin_to_json(pseudo_optional*, bin_to_json_state& state, const abi_type* type, bool) {
-    if (read_bin<uint8_t>(state.bin))
-        return type->optional_of->ser && type->optional_of->ser->bin_to_json(state, type->optional_of, true);
-    state.writer.Null();
-    return true;
+inline bool bin_to_json(input_buffer& bin, const abi_type* type, output_stream& stream) {
+    bin_to_json_state state;
+    bool ok = bin_to_json(state, bin, type, stream);
+    bin = state.bin;
+    return ok;
 }
 
-inline bool bin_to_json(pseudo_object*, bin_to_json_state& state, const abi_type* type, bool start) {
-    if (start) {
-        if (trace_bin_to_json)
-            printf("%*s{ %d fields\n", int(state.stack.size() * 4), "", int(type->fields.size()));
-        state.stack.push_back({type});
-        state.writer.StartObject();
-        return true;
-    }
-    auto& stack_entry = state.stack.back();
-    if (++stack_entry.position < (ptrdiff_t)type->fields.size()) {
-        auto& field = type->fields[stack_entry.position];
-        if (trace_bin_to_json)
-            printf("%*sfield %d/%d: %s\n", int(state.stack.size() * 4), "", int(stack_entry.position),
-                   int(type->fields.size()), std::string{field.name}.c_str());
-        state.writer.Key(field.name.c_str(), field.name.length());
-        return field.type->ser && field.type->ser->bin_to_json(state, field.type, true);
-    } else {
-        if (trace_bin_to_json)
-            printf("%*s}\n", int((state.stack.size() - 1) * 4), "");
-        state.stack.pop_back();
-        state.writer.EndObject();
-        return true;
-    }
-}
-
-inline bool bin_to_json(pseudo_array*, bin_to_json_state& state, const abi_type* type, bool start) {
-    if (start) {
-        state.stack.push_back({type});
-        state.stack.back().array_size = read_varuint32(state.bin);
-        if (trace_bin_to_json)
-            printf("%*s[ %d items\n", int(state.stack.size() * 4), "", int(state.stack.back().array_size));
-        state.writer.StartArray();
-        return true;
-    }
-    auto& stack_entry = state.stack.back();
-    if (++stack_entry.position < (ptrdiff_t)stack_entry.array_size) {
-        if (trace_bin_to_json)
-            printf("%*sitem %d/%d %p %s\n", int(state.stack.size() * 4), "", int(stack_entry.position),
-                   int(stack_entry.array_size), type->array_of->ser, type->array_of->name.c_str());
-        return type->array_of->ser && type->array_of->ser->bin_to_json(state, type->array_of, true);
-    } else {
-        if (trace_bin_to_json)
-            printf("%*s]\n", int((state.stack.size()) * 4), "");
-        state.stack.pop_back();
-        state.writer.EndArray();
-        return true;
-    }
+inline bool bin_to_json(input_buffer& bin, const abi_type* type, hooked_string& dest) {
+    dest.clear();
+    output_stream stream{dest};
+    bool ok = bin_to_json(bin, type, stream);
+    stream.finish();
+    return ok;
 }
 
 template <typename T>
 auto bin_to_json(T*, bin_to_json_state& state, const abi_type*, bool start)
     -> std::enable_if_t<std::is_arithmetic_v<T>, bool> {
 
+    T v{};
+    if (!read_bin(state, v))
+        return false;
     if constexpr (std::is_same_v<T, bool>) {
-        return state.writer.Bool(read_bin<T>(state.bin));
+        return state.writer.Bool(v);
     } else if constexpr (std::is_floating_point_v<T>) {
-        return state.writer.Double(read_bin<T>(state.bin));
+        return state.writer.Double(v);
     } else if constexpr (sizeof(T) == 8) {
-        auto s = std::to_string(read_bin<T>(state.bin));
-        return state.writer.String(s.c_str(), s.size());
+        char s[24];
+        auto end = std::to_chars(s, s + sizeof(s), v).ptr;
+        return state.writer.String(s, end - s);
     } else if constexpr (std::is_signed_v<T>) {
-        return state.writer.Int64(read_bin<T>(state.bin));
+        return state.writer.Int64(v);
     } else {
-        return state.writer.Uint64(read_bin<T>(state.bin));
+        return state.writer.Uint64(v);
     }
 }
 
 inline bool bin_to_json(std::string*, bin_to_json_state& state, const abi_type*, bool start) {
-    auto s = read_string(state.bin);
-    return state.writer.String(s.c_str(), s.size());
+    std::string_view s;
+    return read_string(state, s, "invalid string size") && state.writer.String(s.data(), s.size());
 }
 
 } // namespace abieos
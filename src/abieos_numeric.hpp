@@ -39,12 +39,13 @@ void negate(std::array<uint8_t, size>& a) {
     }
 }
 
+// Returns nullptr on success or a description of the error
 template <auto size>
-std::array<uint8_t, size> decimal_to_binary(std::string_view s) {
-    std::array<uint8_t, size> result{{0}};
+const char* decimal_to_binary(std::array<uint8_t, size>& result, std::string_view s) {
+    result = {{0}};
     for (auto& src_digit : s) {
         if (src_digit < '0' || src_digit > '9')
-            throw std::runtime_error("invalid number");
+            return "invalid number";
         uint8_t carry = src_digit - '0';
         for (auto& result_byte : result) {
             int x = result_byte * 10 + carry;
@@ -52,14 +53,15 @@ std::array<uint8_t, size> decimal_to_binary(std::string_view s) {
             carry = x >> 8;
         }
         if (carry)
-            throw std::runtime_error("number is out of range");
+            return "number is out of range";
     }
-    return result;
+    return nullptr;
 }
 
-template <auto size>
-std::string binary_to_decimal(const std::array<uint8_t, size>& bin) {
-    std::string result("0");
+
+template <typename String = std::string, auto size>
+String binary_to_decimal(const std::array<uint8_t, size>& bin) {
+    String result("0");
     for (auto byte_it = bin.rbegin(); byte_it != bin.rend(); ++byte_it) {
         int carry = *byte_it;
         for (auto& result_digit : result) {
@@ -0,0 +1,308 @@
+// copyright defined in abieos/LICENSE.txt
+
+#include "abieos.h"
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+const char tokenHexApi[] = "0e656f73696f3a3a6162692f312e30010c6163636f756e745f6e616d65046e61"
+                           "6d6505087472616e7366657200040466726f6d0c6163636f756e745f6e616d65"
+                           "02746f0c6163636f756e745f6e616d65087175616e7469747905617373657404"
+                           "6d656d6f06737472696e67066372656174650002066973737565720c6163636f"
+                           "756e745f6e616d650e6d6178696d756d5f737570706c79056173736574056973"
+                           "737565000302746f0c6163636f756e745f6e616d65087175616e746974790561"
+                           "73736574046d656d6f06737472696e67076163636f756e7400010762616c616e"
+                           "63650561737365740e63757272656e63795f7374617473000306737570706c79"
+                           "0561737365740a6d61785f737570706c79056173736574066973737565720c61"
+                           "63636f756e745f6e616d6503000000572d3ccdcd087472616e73666572000000"
+                           "000000a531760569737375650000000000a86cd4450663726561746500020000"
+                           "00384f4d113203693634010863757272656e6379010675696e74363407616363"
+                           "6f756e740000000000904dc603693634010863757272656e6379010675696e74"
+                           "36340e63757272656e63795f7374617473000000";
+
+const char transferAbi[] = R"({
+    "version": "eosio::abi/1.0",
+    "structs": [
+        {
+            "name": "transfer",
+            "base": "",
+            "fields": [
+                { "name": "from", "type": "name" },
+                { "name": "to", "type": "name" },
+                { "name": "quantity", "type": "asset" },
+                { "name": "memo", "type": "string" }
+            ]
+        }
+    ]
+})";
+
+const char transactionAbi[] = R"({
+    "types": [
+        { "new_type_name": "account_name", "type": "name" },
+        { "new_type_name": "action_name", "type": "name" },
+        { "new_type_name": "permission_name", "type": "name" }
+    ],
+    "structs": [
+        {
+            "name": "permission_level",
+            "base": "",
+            "fields": [
+                { "name": "actor", "type": "account_name" },
+                { "name": "permission", "type": "permission_name" }
+            ]
+        },
+        {
+            "name": "action",
+            "base": "",
+            "fields": [
+                { "name": "account", "type": "account_name" },
+                { "name": "name", "type": "action_name" },
+                { "name": "authorization", "type": "permission_level[]" },
+                { "name": "data", "type": "bytes" }
+            ]
+        },
+        {
+            "name": "extension",
+            "base": "",
+            "fields": [
+                { "name": "type", "type": "uint16" },
+                { "name": "data", "type": "bytes" }
+            ]
+        },
+        {
+            "name": "transaction_header",
+            "base": "",
+            "fields": [
+                { "name": "expiration", "type": "time_point_sec" },
+                { "name": "ref_block_num", "type": "uint16" },
+                { "name": "ref_block_prefix", "type": "uint32" },
+                { "name": "max_net_usage_words", "type": "varuint32" },
+                { "name": "max_cpu_usage_ms", "type": "uint8" },
+                { "name": "delay_sec", "type": "varuint32" }
+            ]
+        },
+        {
+            "name": "transaction",
+            "base": "transaction_header",
+            "fields": [
+                { "name": "context_free_actions", "type": "action[]" },
+                { "name": "actions", "type": "action[]" },
+                { "name": "transaction_extensions", "type": "extension[]" }
+            ]
+        }
+    ]
+})";
+
+const char transfer[] = R"({"from":"useraaaaaaaa","to":"useraaaaaaab","quantity":"0.0001 SYS","memo":"test memo"})";
+
+template <typename T>
+T check(T value, const char* msg = "") {
+    if (!value)
+        throw std::runtime_error(std::string{msg} + " failed");
+    return value;
+}
+
+// Returns conversions per second
+double run(const char* name, int iterations, bool expected, const std::function<bool()>& f) {
+    for (int i = 0; i < iterations / 10; ++i)
+        f();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        if (f() != expected)
+            throw std::runtime_error(std::string{name} + ": unexpected result");
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    auto rate = iterations / elapsed.count();
+    printf("%-40s %12.0f /s\n", name, rate);
+    return rate;
+}
+
+int main() {
+    try {
+        auto context = check(abieos_create(), "abieos_create");
+        auto token = abieos_string_to_name(context, "eosio.token");
+        check(abieos_set_abi(context, token, transferAbi), abieos_get_error(context));
+        check(abieos_json_to_bin(context, token, "transfer", transfer), abieos_get_error(context));
+        std::vector<char> bin{abieos_get_bin_data(context),
+                              abieos_get_bin_data(context) + abieos_get_bin_size(context)};
+        std::vector<char> truncated{bin.begin(), bin.end() - 4};
+        std::string token_abi;
+        for (const char* p = tokenHexApi; p[0] && p[1]; p += 2)
+            token_abi.push_back(char(std::stoi(std::string{p, 2}, nullptr, 16)));
+
+        const int iterations = 200000;
+        auto j2b = run("json_to_bin", iterations, true,
+                       [&] { return abieos_json_to_bin(context, token, "transfer", transfer); });
+        auto j2b_fail = run("json_to_bin: wrong field", iterations, false, [&] {
+            return abieos_json_to_bin(context, token, "transfer",
+                                      R"({"from":"useraaaaaaaa","too":"useraaaaaaab","quantity":"0.0001 SYS"})");
+        });
+        run("json_to_bin: bad number", iterations, false, [&] {
+            return abieos_json_to_bin(context, token, "uint32", R"("4294967296")");
+        });
+        auto b2j = run("bin_to_json", iterations, true, [&] {
+            return abieos_bin_to_json(context, token, "transfer", bin.data(), bin.size()) != nullptr;
+        });
+        auto b2j_fail = run("bin_to_json: truncated", iterations, false, [&] {
+            return abieos_bin_to_json(context, token, "transfer", truncated.data(), truncated.size()) != nullptr;
+        });
+        run("bin_to_json: extra data", iterations, false, [&] {
+            return abieos_bin_to_json(context, token, "uint32", bin.data(), bin.size()) != nullptr;
+        });
+        printf("failure/success throughput: json_to_bin %.2f, bin_to_json %.2f\n", j2b_fail / j2b, b2j_fail / b2j);
+
+        // A struct-heavy payload: a transaction with eight actions, each with two authorizations
+        {
+            std::string trx = R"({"expiration":"2009-02-13T23:31:31.000","ref_block_num":1234,"ref_block_prefix":5678,)"
+                              R"("max_net_usage_words":0,"max_cpu_usage_ms":0,"delay_sec":0,"context_free_actions":[],)"
+                              R"("actions":[)";
+            for (int i = 0; i < 8; ++i)
+                trx += std::string{i ? "," : ""} +
+                       R"({"account":"eosio.token","name":"transfer","authorization":[{"actor":"useraaaaaaaa",)"
+                       R"("permission":"active"},{"actor":"useraaaaaaab","permission":"owner"}],)"
+                       R"("data":"608C31C6187315D6708C31C6187315D60100000000000000045359530000000000"})";
+            trx += R"(],"transaction_extensions":[]})";
+            check(abieos_set_abi(context, 6, transactionAbi), abieos_get_error(context));
+            check(abieos_json_to_bin(context, 6, "transaction", trx.c_str()), abieos_get_error(context));
+            std::vector<char> trx_bin{abieos_get_bin_data(context),
+                                      abieos_get_bin_data(context) + abieos_get_bin_size(context)};
+            run("json_to_bin: transaction, 8 actions", iterations / 10, true,
+                [&] { return abieos_json_to_bin(context, 6, "transaction", trx.c_str()); });
+            run("bin_to_json: transaction, 8 actions", iterations / 10, true, [&] {
+                return abieos_bin_to_json(context, 6, "transaction", trx_bin.data(), trx_bin.size()) != nullptr;
+            });
+        }
+
+        // Alternating between two abis drops each one before it is set again, so every call parses the abi again.
+        // Once other contracts hold both abis, every call shares theirs instead.
+        std::string respaced = std::string{transferAbi} + " ";
+        int abi_calls = 0;
+        auto alternate = [&] { return abieos_set_abi(context, 0, ++abi_calls % 2 ? transferAbi : respaced.c_str()); };
+        auto fresh = run("set_abi: new abi", iterations / 20, true, alternate);
+        auto compile = run("set_abi: new abi, then compile on use", iterations / 20, true, [&] {
+            return alternate() && abieos_json_to_bin(context, 0, "transfer", transfer);
+        });
+        check(abieos_set_abi(context, 1, transferAbi), abieos_get_error(context));
+        check(abieos_set_abi(context, 2, respaced.c_str()), abieos_get_error(context));
+        auto shared = run("set_abi: identical to another contract", iterations / 20, true, alternate);
+        printf("set_abi throughput vs. set and compile: new %.2f, shared %.2f\n", fresh / compile, shared / compile);
+        std::string padded = token_abi + '\0';
+        run("set_abi_bin: new abi", iterations / 20, true, [&] {
+            auto& abi = ++abi_calls % 2 ? token_abi : padded;
+            return abieos_set_abi_bin(context, 4, abi.data(), abi.size());
+        });
+        run("set_abi_bin: new abi, then compile on use", iterations / 20, true, [&] {
+            auto& abi = ++abi_calls % 2 ? token_abi : padded;
+            return abieos_set_abi_bin(context, 4, abi.data(), abi.size()) &&
+                   abieos_json_to_bin(context, 4, "transfer", transfer);
+        });
+
+        // A contract with a long history; versions alternate between two abis, so only two compile
+        for (uint32_t i = 0; i < 1000; ++i)
+            check(abieos_set_abi_at(context, 3, i * 1000, i % 2 ? transferAbi : respaced.c_str()),
+                  abieos_get_error(context));
+        uint32_t height = 0;
+        auto historic = run("bin_to_json_at, 1000 abi versions", iterations, true, [&] {
+            height = (height + 7919) % 1'000'000;
+            return abieos_bin_to_json_at(context, 3, height, "transfer", bin.data(), bin.size()) != nullptr;
+        });
+        printf("bin_to_json_at/bin_to_json throughput: %.2f\n", historic / b2j);
+
+        // Time to set and compile synthetic abis: a deep inheritance chain of n structs with one field each, and n
+        // unrelated structs with ten fields each. Both should grow linearly with n.
+        {
+            auto compile_time = [&](const std::string& abi, const char* type) {
+                auto start = std::chrono::steady_clock::now();
+                check(abieos_set_abi(context, 5, abi.c_str()), abieos_get_error(context));
+                auto bin = abieos_bin_to_json(context, 5, type, "", 0); // compiles; fails on the empty input
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                check(!bin, "bin_to_json");
+                return elapsed.count();
+            };
+            for (int n : {100, 1000, 10000}) {
+                std::string deep = R"({"structs":[{"name":"s0","base":"","fields":[{"name":"f0","type":"uint8"}]})";
+                std::string wide = R"({"structs":[)";
+                for (int i = 1; i < n; ++i)
+                    deep += R"(,{"name":"s)" + std::to_string(i) + R"(","base":"s)" + std::to_string(i - 1) +
+                            R"(","fields":[{"name":"f)" + std::to_string(i) + R"(","type":"uint8"}]})";
+                for (int i = 0; i < n; ++i) {
+                    wide += (i ? R"(,{"name":"s)" : R"({"name":"s)") + std::to_string(i) + R"(","base":"","fields":[)";
+                    for (int j = 0; j < 10; ++j)
+                        wide += (j ? R"(,{"name":"f)" : R"({"name":"f)") + std::to_string(j) + R"(","type":"uint8"})";
+                    wide += "]}";
+                }
+                deep += "]}";
+                wide += "]}";
+                printf("compile %5d structs: deep %.4f s, wide %.4f s\n", n,
+                       compile_time(deep, ("s" + std::to_string(n - 1)).c_str()), compile_time(wide, "s0"));
+            }
+        }
+
+        // Startup: registering many distinct abis vs. loading a saved registry of them
+        {
+            const int contracts = 2000;
+            std::vector<std::string> abis;
+            for (int i = 0; i < contracts; ++i)
+                abis.push_back(std::string{transferAbi} + std::string(i, ' '));
+            auto time = [](const std::function<void()>& f) {
+                auto start = std::chrono::steady_clock::now();
+                f();
+                return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            };
+            auto source = check(abieos_create(), "abieos_create");
+            auto set = time([&] {
+                for (int i = 0; i < contracts; ++i)
+                    check(abieos_set_abi(source, i, abis[i].c_str()), abieos_get_error(source));
+            });
+            check(abieos_save_registry(source, "bench.registry"), abieos_get_error(source));
+            auto loaded = check(abieos_create(), "abieos_create");
+            auto load = time([&] { check(abieos_load_registry(loaded, "bench.registry"), abieos_get_error(loaded)); });
+            printf("%d abis: set_abi %.3f s, load_registry %.3f s\n", contracts, set, load);
+            abieos_destroy(source);
+            abieos_destroy(loaded);
+            remove("bench.registry");
+        }
+
+        // Bulk import of distinct binary abis, each compiled, by thread count
+        {
+            std::vector<std::string> abis;
+            std::vector<abieos_abi_bin> batch;
+            for (uint64_t i = 0; i < 5000; ++i)
+                abis.push_back(token_abi + std::string(reinterpret_cast<const char*>(&i), sizeof(i)));
+            for (uint64_t i = 0; i < abis.size(); ++i)
+                batch.push_back({i, abis[i].data(), abis[i].size()});
+            for (unsigned n = 1; n <= std::thread::hardware_concurrency(); n *= 2) {
+                auto bulk = check(abieos_create(), "abieos_create");
+                auto start = std::chrono::steady_clock::now();
+                check(abieos_set_abis_bin(bulk, batch.data(), batch.size(), n, true, nullptr), abieos_get_error(bulk));
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                printf("set_abis_bin, compile, %2u threads %16.0f /s\n", n, batch.size() / elapsed.count());
+                abieos_destroy(bulk);
+            }
+        }
+
+        for (unsigned n = 1; n <= std::thread::hardware_concurrency(); n *= 2) {
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> threads;
+            for (unsigned i = 0; i < n; ++i) {
+                threads.emplace_back([&] {
+                    for (int j = 0; j < iterations; ++j)
+                        abieos_result_release(
+                            abieos_bin_to_json_concurrent(context, token, "transfer", bin.data(), bin.size(), nullptr));
+                });
+            }
+            for (auto& t : threads)
+                t.join();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            printf("bin_to_json_concurrent, %2u threads %17.0f /s\n", n, n * iterations / elapsed.count());
+        }
+        abieos_destroy(context);
+        return 0;
+    } catch (std::exception& e) {
+        printf("error: %s\n", e.what());
+        return 1;
+    }
+}
@@ -1,9 +1,17 @@
 // copyright defined in abieos/LICENSE.txt
 
 #include "abieos.h"
+#include <cmath>
+#include <memory>
 #include <stdexcept>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <string>
+#include <thread>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
 
 const char tokenHexApi[] = "0e656f73696f3a3a6162692f312e30010c6163636f756e745f6e616d65046e61"
                            "6d6505087472616e7366657200040466726f6d0c6163636f756e745f6e616d65"
@@ -20,6 +28,22 @@ const char tokenHexApi[] = "0e656f73696f3a3a6162692f312e30010c6163636f756e745f6e
                            "6f756e740000000000904dc603693634010863757272656e6379010675696e74"
                            "36340e63757272656e63795f7374617473000000";
 
+const char transferAbi[] = R"({
+    "version": "eosio::abi/1.0",
+    "structs": [
+        {
+            "name": "transfer",
+            "base": "",
+            "fields": [
+                { "name": "from", "type": "name" },
+                { "name": "to", "type": "name" },
+                { "name": "quantity", "type": "asset" },
+                { "name": "memo", "type": "string" }
+            ]
+        }
+    ]
+})";
+
 const char transactionAbi[] = R"({
     "types": [
         {
@@ -137,6 +161,9 @@ const char transactionAbi[] = R"({
     ]
 })";
 
+const char transferJson[] =
+    R"({"from":"useraaaaaaaa","to":"useraaaaaaab","quantity":"0.0001 SYS","memo":"test memo"})";
+
 template <typename T>
 T check(T value, const char* msg = "") {
     if (!value)
@@ -166,6 +193,705 @@ void check_type(abieos_context* context, uint64_t contract, const char* type, co
         throw std::runtime_error("mismatch");
 }
 
+void check_bin_to_json_batch(abieos_context* context, uint64_t token) {
+    check_context(context, abieos_json_to_bin(context, token, "transfer", transferJson));
+    std::string bin(abieos_get_bin_data(context), abieos_get_bin_size(context));
+
+    const char* datas[] = {bin.data(), bin.data(), bin.data()};
+    size_t sizes[] = {bin.size(), bin.size() - 1, bin.size()};
+    size_t offsets[3];
+    abieos_bool ok[3];
+    const char* result =
+        check_context(context, abieos_bin_to_json_batch(context, token, "transfer", datas, sizes, 3, offsets, ok));
+    printf("batch %s | %s | %s\n", result + offsets[0], result + offsets[1], result + offsets[2]);
+    if (!ok[0] || ok[1] || !ok[2] || result + offsets[0] != std::string{transferJson} ||
+        result + offsets[2] != std::string{transferJson})
+        throw std::runtime_error("batch mismatch");
+}
+
+void check_json_to_bin_batch(abieos_context* context, uint64_t token) {
+    check_context(context, abieos_json_to_bin(context, token, "transfer", transferJson));
+    std::string expected(abieos_get_bin_data(context), abieos_get_bin_size(context));
+
+    const char* jsons[] = {transferJson, R"({"from":"useraaaaaaaa"})", transferJson};
+    size_t offsets[3];
+    size_t sizes[3];
+    abieos_bool ok[3];
+    const char* result =
+        check_context(context, abieos_json_to_bin_batch(context, token, "transfer", jsons, 3, offsets, sizes, ok));
+    std::string error(result + offsets[1], sizes[1]);
+    printf("batch error: %s\n", error.c_str());
+    if (!ok[0] || ok[1] || !ok[2] || std::string(result + offsets[0], sizes[0]) != expected ||
+        std::string(result + offsets[2], sizes[2]) != expected)
+        throw std::runtime_error("batch mismatch");
+
+    // an empty batch succeeds, even once its buffer has been released
+    abieos_set_scratch_limit(context, 0);
+    check_context(context, abieos_json_to_bin_batch(context, token, "transfer", nullptr, 0, nullptr, nullptr, nullptr));
+    abieos_set_scratch_limit(context, 256 * 1024);
+}
+
+void check_type_handles(abieos_context* context, uint64_t token) {
+    auto handle = check_context(context, abieos_get_type_handle(context, token, "transfer"));
+    check(handle == abieos_get_type_handle(context, token, "transfer"), "same handle");
+    check_context(context, abieos_json_to_bin_with_handle(context, handle, transferJson));
+    std::string bin(abieos_get_bin_data(context), abieos_get_bin_size(context));
+    std::string result =
+        check_context(context, abieos_bin_to_json_with_handle(context, handle, bin.data(), bin.size()));
+    if (result != transferJson)
+        throw std::runtime_error("handle mismatch");
+
+    // setting an identical abi keeps the compiled contract, and the handle
+    check_context(context, abieos_set_abi_hex(context, token, tokenHexApi));
+    check_context(context, abieos_json_to_bin_with_handle(context, handle, transferJson));
+
+    check_context(context, abieos_set_abi(context, token, transferAbi));
+    if (abieos_json_to_bin_with_handle(context, handle, transferJson))
+        throw std::runtime_error("stale handle was accepted");
+    printf("stale handle: %s\n", abieos_get_error(context));
+    check(handle == abieos_get_type_handle(context, token, "transfer"), "refreshed handle");
+    check_context(context, abieos_json_to_bin_with_handle(context, handle, transferJson));
+    check_context(context, abieos_set_abi_hex(context, token, tokenHexApi));
+}
+
+void check_into(abieos_context* context, uint64_t token) {
+    check_context(context, abieos_json_to_bin(context, token, "transfer", transferJson));
+    std::string expected(abieos_get_bin_data(context), abieos_get_bin_size(context));
+
+    char small[8];
+    char big[256];
+    size_t needed = 0;
+    if (abieos_json_to_bin_into(context, token, "transfer", transferJson, small, sizeof(small), &needed) ||
+        needed != expected.size())
+        throw std::runtime_error("json_to_bin_into didn't report size");
+    check_context(context,
+                  abieos_json_to_bin_into(context, token, "transfer", transferJson, big, sizeof(big), &needed));
+    if (std::string(big, needed) != expected)
+        throw std::runtime_error("json_to_bin_into mismatch");
+
+    if (abieos_bin_to_json_into(context, token, "transfer", expected.data(), expected.size(), small, sizeof(small),
+                                &needed) ||
+        needed != strlen(transferJson) + 1)
+        throw std::runtime_error("bin_to_json_into didn't report size");
+    check_context(context, abieos_bin_to_json_into(context, token, "transfer", expected.data(), expected.size(), big,
+                                                   sizeof(big), &needed));
+    if (big != std::string{transferJson})
+        throw std::runtime_error("bin_to_json_into mismatch");
+}
+
+void check_results(abieos_context* context, uint64_t token) {
+    auto bin = check_context(context, abieos_json_to_bin_result(context, token, "transfer", transferJson));
+    auto json = check_context(context, abieos_bin_to_json_result(context, token, "transfer", abieos_result_data(bin),
+                                                                 abieos_result_size(bin)));
+    auto json2 = check_context(context, abieos_bin_to_json_result(context, token, "transfer", abieos_result_data(bin),
+                                                                  abieos_result_size(bin)));
+    if (abieos_result_data(json) == abieos_result_data(json2) ||
+        abieos_result_data(json) != std::string{transferJson} || abieos_result_size(json) != strlen(transferJson))
+        throw std::runtime_error("result mismatch");
+    if (abieos_bin_to_json_result(context, token, "transfer", abieos_result_data(bin), abieos_result_size(bin) - 1))
+        throw std::runtime_error("truncated data was accepted");
+    abieos_result_retain(json);
+    abieos_result_release(json);
+    abieos_result_release(json2);
+    abieos_result_release(bin);
+    if (abieos_result_data(json) != std::string{transferJson})
+        throw std::runtime_error("retained result changed");
+    abieos_result_release(json);
+}
+
+struct test_allocator {
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    int64_t bytes = 0;
+};
+
+void check_allocator() {
+    test_allocator a;
+    auto context = check(abieos_create_with_allocator(
+        [](void* user, size_t size) {
+            auto& a = *static_cast<test_allocator*>(user);
+            ++a.allocations;
+            a.bytes += size;
+            return malloc(size);
+        },
+        [](void* user, void* p, size_t size) {
+            auto& a = *static_cast<test_allocator*>(user);
+            ++a.frees;
+            a.bytes -= size;
+            free(p);
+        },
+        &a));
+    auto token = abieos_string_to_name(context, "eosio.token");
+    abieos_alloc_stats stats;
+    check(abieos_get_alloc_stats(context, &stats), "abieos_get_alloc_stats");
+    auto empty = stats.bytes_in_use;
+    check_context(context, abieos_set_abi_hex(context, token, tokenHexApi));
+    check(abieos_get_alloc_stats(context, &stats), "abieos_get_alloc_stats");
+    auto registered = stats.bytes_in_use - empty;
+    abieos_registry_stats registry_stats;
+    check(abieos_registry_get_stats(abieos_get_registry(context), &registry_stats), "abieos_registry_get_stats");
+    if (registry_stats.compiles)
+        throw std::runtime_error("abi was compiled before its first use");
+    check_context(context, abieos_json_to_bin(context, token, "transfer", transferJson));
+    check(abieos_get_alloc_stats(context, &stats), "abieos_get_alloc_stats");
+    auto compiled = stats.bytes_in_use - empty;
+    printf("abi: %llu bytes registered, %llu bytes after first use\n", (unsigned long long)registered,
+           (unsigned long long)compiled);
+    check(abieos_registry_get_stats(abieos_get_registry(context), &registry_stats), "abieos_registry_get_stats");
+    if (compiled <= registered || registry_stats.compiles != 1)
+        throw std::runtime_error("abi wasn't compiled on its first use");
+    check_context(context, abieos_hex_to_json(context, token, "transfer", abieos_get_bin_hex(context)));
+
+    // contracts set from identical bytes share one compiled abi
+    auto clone = abieos_string_to_name(context, "token.clone");
+    check(abieos_get_alloc_stats(context, &stats), "abieos_get_alloc_stats");
+    auto before_clone = stats.bytes_in_use;
+    check_context(context, abieos_set_abi_hex(context, clone, tokenHexApi));
+    check(abieos_get_alloc_stats(context, &stats), "abieos_get_alloc_stats");
+    if (stats.bytes_in_use - before_clone > registered / 2)
+        throw std::runtime_error("identical abi was stored again");
+    check_context(context, abieos_hex_to_json(context, clone, "transfer", abieos_get_bin_hex(context)));
+
+    // repeated conversions reuse the context's buffers and scratch arena
+    std::vector<char> bin{abieos_get_bin_data(context), abieos_get_bin_data(context) + abieos_get_bin_size(context)};
+    check_context(context, abieos_set_abi(context, 0, transactionAbi));
+    const char* bytes = R"("000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F")";
+    check_context(context, abieos_json_to_bin(context, 0, "bytes", bytes));
+    std::vector<char> bytes_bin{abieos_get_bin_data(context),
+                                abieos_get_bin_data(context) + abieos_get_bin_size(context)};
+    check_context(context, abieos_bin_to_json(context, 0, "bytes", bytes_bin.data(), bytes_bin.size()));
+    check(abieos_get_alloc_stats(context, &stats), "abieos_get_alloc_stats");
+    auto warm = stats.allocations;
+    for (int i = 0; i < 10; ++i) {
+        check_context(context, abieos_json_to_bin(context, token, "transfer", transferJson));
+        check_context(context, abieos_bin_to_json(context, token, "transfer", bin.data(), bin.size()));
+        check_context(context, abieos_bin_to_json(context, 0, "bytes", bytes_bin.data(), bytes_bin.size()));
+    }
+    check(abieos_get_alloc_stats(context, &stats), "abieos_get_alloc_stats");
+    if (stats.allocations != warm)
+        throw std::runtime_error("conversions allocated after warm-up");
+
+    printf("allocator: %llu allocations, %llu bytes in use\n", (unsigned long long)stats.allocations,
+           (unsigned long long)stats.bytes_in_use);
+    if (!a.allocations || stats.allocations != a.allocations || stats.deallocations != a.frees ||
+        stats.bytes_in_use != (uint64_t)a.bytes)
+        throw std::runtime_error("allocator stats mismatch");
+
+    // the private registry outlives its context when another context shares it
+    auto sharer = check(abieos_create_with_registry(abieos_get_registry(context)));
+    abieos_destroy(context);
+    check_context(sharer, abieos_bin_to_json(sharer, token, "transfer", bin.data(), bin.size()));
+    check_context(sharer, abieos_set_abi_hex(sharer, token, tokenHexApi));
+    check_context(sharer, abieos_json_to_bin(sharer, token, "transfer", transferJson));
+    abieos_destroy(sharer);
+    if (a.allocations != a.frees || a.bytes)
+        throw std::runtime_error("allocator leaked");
+}
+
+void check_concurrent() {
+    auto context = check(abieos_create());
+    auto token = abieos_string_to_name(context, "eosio.token");
+    check_context(context, abieos_set_abi_hex(context, token, tokenHexApi));
+    check_context(context, abieos_json_to_bin(context, token, "transfer", transferJson));
+    std::string bin{abieos_get_bin_data(context), abieos_get_bin_data(context) + abieos_get_bin_size(context)};
+
+    std::vector<std::thread> threads;
+    std::vector<std::string> failures(4);
+    for (size_t i = 0; i < failures.size(); ++i) {
+        threads.emplace_back([&, i] {
+            for (int j = 0; j < 500 && failures[i].empty(); ++j) {
+                abieos_result* error = nullptr;
+                auto* b = abieos_json_to_bin_concurrent(context, token, "transfer", transferJson, &error);
+                if (!b || std::string{abieos_result_data(b), abieos_result_size(b)} != bin)
+                    failures[i] = error ? abieos_result_data(error) : "json_to_bin_concurrent mismatch";
+                auto* j2 = abieos_bin_to_json_concurrent(context, token, "transfer", bin.data(), bin.size(), &error);
+                if (!j2 || abieos_result_data(j2) != std::string{transferJson})
+                    failures[i] = error ? abieos_result_data(error) : "bin_to_json_concurrent mismatch";
+                auto* a = abieos_json_to_bin_concurrent(context, token, j % 2 ? "uint8[]" : "name[]", "[]", &error);
+                if (!a)
+                    failures[i] = error ? abieos_result_data(error) : "json_to_bin_concurrent failed";
+                abieos_result_release(b);
+                abieos_result_release(j2);
+                abieos_result_release(a);
+                abieos_result_release(error);
+
+                if (abieos_bin_to_json_concurrent(context, token, "transfer", bin.data(), 4, &error))
+                    failures[i] = "expected failure";
+                else if (!error || abieos_result_data(error) != std::string{"read past end"})
+                    failures[i] = "expected error result";
+                abieos_result_release(error);
+            }
+        });
+    }
+    for (int i = 0; i < 20; ++i) // distinct abis, so each is compiled and swapped in
+        check_context(context, i % 2 ? abieos_set_abi(context, token, transferAbi)
+                                     : abieos_set_abi_hex(context, token, tokenHexApi));
+    for (auto& t : threads)
+        t.join();
+    for (auto& f : failures)
+        if (!f.empty())
+            throw std::runtime_error("concurrent: " + f);
+    abieos_destroy(context);
+}
+
+void check_abi_errors() {
+    auto context = check(abieos_create());
+    const char* unknown = R"({"structs":[{"name":"s","base":"","fields":[{"name":"f","type":"nope[]"}]}]})";
+    if (abieos_set_abi(context, 0, unknown) || abieos_get_error(context) != std::string{"unknown type \"nope\""})
+        throw std::runtime_error("abi with unknown type was accepted");
+    const char* redefined = R"({"types":[{"new_type_name":"name","type":"uint64"}]})";
+    if (abieos_set_abi(context, 0, redefined) ||
+        abieos_get_error(context) != std::string{"abi redefines type \"name\""})
+        throw std::runtime_error("abi redefining a type was accepted");
+    const char* negative = R"({"error_messages":[{"error_code":"-1","error_msg":"x"}]})";
+    if (abieos_set_abi(context, 0, negative) ||
+        abieos_get_error(context) != std::string{"expected non-negative number"})
+        throw std::runtime_error("abi with a negative error code was accepted");
+
+    // cycles are only found when the abi is compiled, on first use
+    const char* cycle = R"({"types":[{"new_type_name":"a","type":"b"},{"new_type_name":"b","type":"a"}]})";
+    check_context(context, abieos_set_abi(context, 0, cycle));
+    if (abieos_json_to_bin(context, 0, "uint8", "1") ||
+        abieos_get_error(context) != std::string{"abi recursion limit reached"})
+        throw std::runtime_error("abi with a cycle was compiled");
+
+    // binary abis are read in place; every truncation of one must fail cleanly
+    std::string token_abi;
+    for (const char* p = tokenHexApi; p[0] && p[1]; p += 2)
+        token_abi.push_back(char(std::stoi(std::string{p, 2}, nullptr, 16)));
+    for (size_t size = 1; size < token_abi.size(); ++size)
+        if (abieos_set_abi_bin(context, 1, token_abi.data(), size))
+            throw std::runtime_error("truncated binary abi was accepted");
+    check_context(context, abieos_set_abi_bin(context, 1, token_abi.data(), token_abi.size()));
+    check_context(context, abieos_get_type_for_action(context, 1, abieos_string_to_name(context, "transfer")));
+    abieos_destroy(context);
+}
+
+void check_eviction() {
+    auto context = check(abieos_create());
+    auto registry = abieos_get_registry(context);
+    std::string respaced = std::string{transferAbi} + " ";
+    check_context(context, abieos_set_abi_hex(context, 1, tokenHexApi));
+    check_context(context, abieos_set_abi(context, 2, transferAbi));
+    check_context(context, abieos_set_abi(context, 3, respaced.c_str()));
+    auto handle = check_context(context, abieos_get_type_handle(context, 1, "transfer"));
+
+    abieos_registry_stats stats;
+    check(abieos_registry_get_stats(registry, &stats), "abieos_registry_get_stats");
+    if (stats.compiled != 1 || !stats.compiled_bytes || stats.compiles != 1)
+        throw std::runtime_error("expected one compiled contract");
+    check(abieos_registry_set_compiled_limit(registry, 1), "abieos_registry_set_compiled_limit");
+
+    // with a limit below any contract's size, each compile evicts every other contract
+    check_context(context, abieos_json_to_bin(context, 2, "transfer", transferJson));
+    check_context(context, abieos_json_to_bin_with_handle(context, handle, transferJson));
+    check_context(context, abieos_get_type_for_action(context, 1, abieos_string_to_name(context, "transfer")));
+    check_context(context, abieos_json_to_bin(context, 3, "transfer", transferJson));
+    check_context(context, abieos_json_to_bin(context, 2, "transfer", transferJson));
+    check(abieos_registry_get_stats(registry, &stats), "abieos_registry_get_stats");
+    printf("eviction: %llu compiles, %llu recompiles, %llu evictions\n", (unsigned long long)stats.compiles,
+           (unsigned long long)stats.recompiles, (unsigned long long)stats.evictions);
+    if (stats.compiled != 1 || stats.compiles != 5 || stats.recompiles != 2 || stats.evictions != 4)
+        throw std::runtime_error("unexpected eviction stats");
+
+    // conversions using a contract keep it from being evicted under them
+    std::string bin{abieos_get_bin_data(context), abieos_get_bin_data(context) + abieos_get_bin_size(context)};
+    std::vector<std::thread> threads;
+    std::vector<std::string> failures(4);
+    for (size_t i = 0; i < failures.size(); ++i) {
+        threads.emplace_back([&, i] {
+            for (int j = 0; j < 200 && failures[i].empty(); ++j) {
+                abieos_result* error = nullptr;
+                auto* json = abieos_bin_to_json_concurrent(context, (i + j) % 3 + 1, "transfer", bin.data(), bin.size(),
+                                                           &error);
+                if (!json || abieos_result_data(json) != std::string{transferJson})
+                    failures[i] = error ? abieos_result_data(error) : "bin_to_json_concurrent mismatch";
+                abieos_result_release(json);
+                abieos_result_release(error);
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    for (auto& f : failures)
+        if (!f.empty())
+            throw std::runtime_error("eviction: " + f);
+
+    check(abieos_registry_set_compiled_limit(registry, 0), "abieos_registry_set_compiled_limit");
+    check_context(context, abieos_json_to_bin_with_handle(context, handle, transferJson));
+    check_context(context, abieos_json_to_bin(context, 2, "transfer", transferJson));
+    check_context(context, abieos_json_to_bin(context, 3, "transfer", transferJson));
+    check(abieos_registry_get_stats(registry, &stats), "abieos_registry_get_stats");
+    if (stats.compiled != 3)
+        throw std::runtime_error("contracts were evicted without a limit");
+    abieos_destroy(context);
+}
+
+void check_history() {
+    auto context = check(abieos_create());
+    auto token = abieos_string_to_name(context, "eosio.token");
+    const char* old_abi = R"({"structs":[{"name":"transfer","base":"","fields":[
+        {"name":"from","type":"name"},{"name":"to","type":"name"},{"name":"quantity","type":"asset"}]}]})";
+    check_context(context, abieos_set_abi_at(context, token, 100, old_abi));
+    check_context(context, abieos_set_abi_at(context, token, 300, old_abi));
+    check_context(context, abieos_set_abi_at(context, token, 400, transferAbi));
+    check_context(context, abieos_set_abi_at(context, token, 200, transferAbi));
+
+    const char* old_transfer = R"({"from":"useraaaaaaaa","to":"useraaaaaaab","quantity":"0.0001 SYS"})";
+    if (abieos_json_to_bin_at(context, token, 99, "transfer", old_transfer))
+        throw std::runtime_error("converted before the first abi version");
+    printf("history: %s\n", abieos_get_error(context));
+    check_context(context, abieos_json_to_bin_at(context, token, 100, "transfer", old_transfer));
+    check_context(context, abieos_json_to_bin_at(context, token, 299, "transfer", transferJson));
+    check_context(context, abieos_json_to_bin_at(context, token, 300, "transfer", old_transfer));
+    check_context(context, abieos_json_to_bin(context, token, "transfer", transferJson));
+    if (abieos_json_to_bin_at(context, token, 250, "transfer", old_transfer))
+        throw std::runtime_error("converted with the wrong abi version");
+
+    // versions set from identical bytes share one compiled abi
+    abieos_registry_stats stats;
+    check(abieos_registry_get_stats(abieos_get_registry(context), &stats), "abieos_registry_get_stats");
+    if (stats.compiles != 2)
+        throw std::runtime_error("abi versions weren't shared");
+
+    // setting an abi without a height replaces the history
+    check_context(context, abieos_set_abi(context, token, old_abi));
+    check_context(context, abieos_json_to_bin_at(context, token, 0, "transfer", old_transfer));
+    check_context(context, abieos_json_to_bin_at(context, token, 400, "transfer", old_transfer));
+    abieos_destroy(context);
+}
+
+void check_saved_registry() {
+    const char* path = "abieos-test.registry";
+    auto token = abieos_string_to_name(nullptr, "eosio.token");
+    auto clone = abieos_string_to_name(nullptr, "token.clone");
+    auto cyclic = abieos_string_to_name(nullptr, "cyclic");
+    std::string bin;
+    {
+        auto context = check(abieos_create());
+        check_context(context, abieos_set_abi_hex_at(context, token, 10, tokenHexApi));
+        check_context(context, abieos_set_abi_at(context, token, 20, transferAbi));
+        check_context(context, abieos_set_abi_hex(context, clone, tokenHexApi));
+        const char* cycle = R"({"types":[{"new_type_name":"a","type":"b"},{"new_type_name":"b","type":"a"}]})";
+        check_context(context, abieos_set_abi(context, cyclic, cycle)); // saved without a contract
+        check_context(context, abieos_json_to_bin(context, token, "transfer", transferJson));
+        bin.assign(abieos_get_bin_data(context), abieos_get_bin_size(context));
+        check_context(context, abieos_save_registry(context, path));
+        abieos_destroy(context);
+    }
+
+    auto context = check(abieos_create());
+    check_context(context, abieos_load_registry(context, path));
+    abieos_registry_stats stats;
+    check(abieos_registry_get_stats(abieos_get_registry(context), &stats), "abieos_registry_get_stats");
+    if (stats.compiles)
+        throw std::runtime_error("loading a registry compiled abis");
+    if (abieos_bin_to_json_at(context, token, 15, "transfer", bin.data(), bin.size()) != std::string{transferJson} ||
+        abieos_bin_to_json(context, token, "transfer", bin.data(), bin.size()) != std::string{transferJson} ||
+        abieos_bin_to_json(context, clone, "transfer", bin.data(), bin.size()) != std::string{transferJson})
+        throw std::runtime_error("loaded registry mismatch");
+    if (abieos_json_to_bin_at(context, token, 5, "transfer", transferJson))
+        throw std::runtime_error("loaded registry has an abi before its first version");
+    check(abieos_registry_get_stats(abieos_get_registry(context), &stats), "abieos_registry_get_stats");
+    if (stats.compiles || stats.compiled)
+        throw std::runtime_error("loaded contracts were compiled instead of used in place");
+    if (abieos_json_to_bin(context, cyclic, "uint8", "1") ||
+        abieos_get_error(context) != std::string{"abi recursion limit reached"})
+        throw std::runtime_error("loaded abi with a cycle was compiled");
+
+    // saving over a loaded file leaves the loaded abis intact
+    check_context(context, abieos_save_registry(context, path));
+    check_context(context, abieos_bin_to_json(context, clone, "transfer", bin.data(), bin.size()));
+
+    std::string contents;
+    {
+        std::unique_ptr<FILE, int (*)(FILE*)> f{fopen(path, "rb"), fclose};
+        char buf[4096];
+        for (size_t n; f && (n = fread(buf, 1, sizeof(buf), f.get()));)
+            contents.append(buf, n);
+    }
+    // contracts are used where they're mapped, so loading must reject damage to them which conversions would trip over
+    size_t rejected = 0;
+    for (size_t i = contents.size() - std::min<size_t>(contents.size(), 2048); i < contents.size(); ++i) {
+        auto damaged = contents;
+        damaged[i] ^= 0x55;
+        std::unique_ptr<FILE, int (*)(FILE*)> f{fopen(path, "wb"), fclose};
+        fwrite(damaged.data(), 1, damaged.size(), f.get());
+        f.reset();
+        if (!abieos_load_registry(context, path)) {
+            if (!rejected++)
+                printf("damaged registry: %s\n", abieos_get_error(context));
+            continue;
+        }
+        abieos_bin_to_json(context, token, "transfer", bin.data(), bin.size());
+        abieos_json_to_bin(context, token, "transfer", transferJson);
+    }
+    if (!rejected)
+        throw std::runtime_error("no damaged registry file was rejected");
+    for (auto [size, name] : {std::pair{contents.size() - 1, "truncated"}, std::pair{size_t(4), "short"}}) {
+        std::unique_ptr<FILE, int (*)(FILE*)> f{fopen(path, "wb"), fclose};
+        fwrite(contents.data(), 1, size, f.get());
+        f.reset();
+        if (abieos_load_registry(context, path))
+            throw std::runtime_error(std::string{name} + " registry file was loaded");
+        printf("%s registry: %s\n", name, abieos_get_error(context));
+    }
+    remove(path);
+    if (abieos_load_registry(context, path))
+        throw std::runtime_error("missing registry file was loaded");
+    printf("missing registry: %s\n", abieos_get_error(context));
+    abieos_destroy(context);
+}
+
+void check_shared_registry() {
+    std::string name = "/abieos-test-" + std::to_string(getpid());
+    const char* memoless = R"({"from":"useraaaaaaaa","to":"useraaaaaaab","quantity":"0.0001 SYS"})";
+    const char* memolessAbi = R"({
+        "version": "eosio::abi/1.0",
+        "structs": [{"name": "transfer", "base": "", "fields": [
+            { "name": "from", "type": "name" }, { "name": "to", "type": "name" },
+            { "name": "quantity", "type": "asset" }
+        ]}]
+    })";
+    auto token = abieos_string_to_name(nullptr, "eosio.token");
+    auto other = abieos_string_to_name(nullptr, "other");
+
+    auto publisher = check(abieos_create());
+    check_context(publisher, abieos_set_abi(publisher, token, transferAbi));
+    check_context(publisher, abieos_publish_shared_registry(publisher, name.c_str()));
+
+    auto worker = check(abieos_create());
+    check_context(worker, abieos_set_abi(worker, other, transferAbi));
+    check_context(worker, abieos_attach_shared_registry(worker, name.c_str()));
+    if (abieos_attach_shared_registry(worker, name.c_str()))
+        throw std::runtime_error("registry attached twice");
+    printf("attach twice: %s\n", abieos_get_error(worker));
+    check_context(worker, abieos_json_to_bin(worker, token, "transfer", transferJson));
+    abieos_registry_stats stats;
+    check(abieos_registry_get_stats(abieos_get_registry(worker), &stats), "abieos_registry_get_stats");
+    if (stats.compiles || stats.compiled)
+        throw std::runtime_error("attached registry compiled a published contract");
+    if (abieos_json_to_bin(worker, other, "transfer", transferJson))
+        throw std::runtime_error("attaching kept a contract the publication doesn't have");
+    if (abieos_json_to_bin(worker, token, "transfer", memoless))
+        throw std::runtime_error("memo is optional before republishing");
+
+    // the worker picks up each new publication on its next call, and a second attached registry starts from the latest
+    check_context(publisher, abieos_set_abi(publisher, token, memolessAbi));
+    check_context(publisher, abieos_publish_shared_registry(publisher, name.c_str()));
+    check_context(worker, abieos_json_to_bin(worker, token, "transfer", memoless));
+    auto late = check(abieos_create());
+    check_context(late, abieos_attach_shared_registry(late, name.c_str()));
+    check_context(late, abieos_json_to_bin(late, token, "transfer", memoless));
+
+    // concurrent publishers never write or unlink each other's publications
+    auto rival = check(abieos_create());
+    check_context(rival, abieos_set_abi(rival, token, memolessAbi));
+    std::thread rival_thread{[&] {
+        for (int i = 0; i < 20; ++i)
+            check_context(rival, abieos_publish_shared_registry(rival, name.c_str()));
+    }};
+    for (int i = 0; i < 20; ++i) {
+        check_context(publisher, abieos_publish_shared_registry(publisher, name.c_str()));
+        check_context(worker, abieos_json_to_bin(worker, token, "transfer", memoless));
+    }
+    rival_thread.join();
+    abieos_destroy(rival);
+    check_context(worker, abieos_json_to_bin(worker, token, "transfer", memoless));
+
+    check_context(publisher, abieos_unlink_shared_registry(publisher, name.c_str()));
+    check_context(worker, abieos_json_to_bin(worker, token, "transfer", memoless));
+    auto missing = check(abieos_create());
+    if (abieos_attach_shared_registry(missing, name.c_str()))
+        throw std::runtime_error("unlinked shared registry was attached");
+    printf("missing shared registry: %s\n", abieos_get_error(missing));
+    abieos_destroy(missing);
+    abieos_destroy(late);
+    abieos_destroy(worker);
+    abieos_destroy(publisher);
+}
+
+void check_bulk_abis() {
+    std::string token_abi;
+    for (const char* p = tokenHexApi; p[0] && p[1]; p += 2)
+        token_abi.push_back(char(std::stoi(std::string{p, 2}, nullptr, 16)));
+
+    auto context = check(abieos_create());
+    check_context(context, abieos_set_abi(context, 10, transferAbi));
+    std::vector<abieos_abi_bin> abis;
+    for (uint64_t i = 0; i < 64; ++i)
+        abis.push_back({i, token_abi.data(), token_abi.size()});
+    abis[10].size /= 2;
+    abis[20].data = nullptr;
+    std::vector<const char*> errors(abis.size());
+    if (abieos_set_abis_bin(context, abis.data(), abis.size(), 4, true, errors.data()))
+        throw std::runtime_error("bulk import with bad abis succeeded");
+    printf("bulk import: %s\n", abieos_get_error(context));
+    for (size_t i = 0; i < abis.size(); ++i)
+        if (!errors[i] != (i != 10 && i != 20))
+            throw std::runtime_error("bulk import reported the wrong abis as failed");
+    printf("bulk import, truncated abi: %s\n", errors[10]);
+
+    abieos_registry_stats stats;
+    check(abieos_registry_get_stats(abieos_get_registry(context), &stats), "abieos_registry_get_stats");
+    if (stats.compiles != 1)
+        throw std::runtime_error("identical abis in a bulk import weren't shared");
+    check_context(context, abieos_json_to_bin(context, 63, "transfer", transferJson));
+    check_context(context, abieos_json_to_bin(context, 10, "transfer", transferJson)); // kept its abi
+    if (abieos_json_to_bin(context, 20, "transfer", transferJson))
+        throw std::runtime_error("failed bulk import set an abi");
+    check(abieos_registry_get_stats(abieos_get_registry(context), &stats), "abieos_registry_get_stats");
+    if (stats.compiles != 2)
+        throw std::runtime_error("bulk import didn't compile its abis");
+    check_context(context, abieos_set_abis_bin(context, abis.data() + 30, 10, 0, false, nullptr));
+    abieos_destroy(context);
+}
+
+void check_inheritance() {
+    auto context = check(abieos_create());
+    // a chain deeper than the recursion limit, a sibling which can't share its base's fields, and a builtin base
+    std::string abi = R"({"structs":[{"name":"s0","base":"","fields":[{"name":"f0","type":"uint8"}]})";
+    std::string json = R"({"f0":0)";
+    for (int i = 1; i < 100; ++i) {
+        abi += R"(,{"name":"s)" + std::to_string(i) + R"(","base":"s)" + std::to_string(i - 1) +
+               R"(","fields":[{"name":"f)" + std::to_string(i) + R"(","type":"uint8"}]})";
+        json += R"(,"f)" + std::to_string(i) + R"(":)" + std::to_string(i);
+    }
+    abi += R"(,{"name":"sibling","base":"base50","fields":[{"name":"g","type":"string"}]})";
+    abi += R"(,{"name":"token","base":"extended_asset","fields":[{"name":"memo","type":"string"}]}])";
+    abi += R"(,"types":[{"new_type_name":"base50","type":"s50"}]})";
+    json += "}";
+    check_context(context, abieos_set_abi(context, 0, abi.c_str()));
+    check_context(context, abieos_json_to_bin(context, 0, "s99", json.c_str()));
+    std::string bin(abieos_get_bin_data(context), abieos_get_bin_size(context));
+    if (bin.size() != 100 || abieos_bin_to_json(context, 0, "s99", bin.data(), bin.size()) != json)
+        throw std::runtime_error("deep inheritance mismatch");
+    std::string sibling = json.substr(0, json.find(R"(,"f51")")) + R"(,"g":"x"})";
+    check_context(context, abieos_json_to_bin(context, 0, "sibling", sibling.c_str()));
+    bin.assign(abieos_get_bin_data(context), abieos_get_bin_size(context));
+    if (abieos_bin_to_json(context, 0, "sibling", bin.data(), bin.size()) != sibling)
+        throw std::runtime_error("sibling of a derived struct mismatch");
+    const char* token = R"({"quantity":"0.0001 SYS","contract":"eosio.token","memo":"m"})";
+    check_context(context, abieos_json_to_bin(context, 0, "token", token));
+    bin.assign(abieos_get_bin_data(context), abieos_get_bin_size(context));
+    if (abieos_bin_to_json(context, 0, "token", bin.data(), bin.size()) != std::string{token})
+        throw std::runtime_error("struct derived from extended_asset mismatch");
+
+    const char* cycle = R"({"structs":[{"name":"a","base":"b","fields":[]},{"name":"b","base":"a","fields":[]}]})";
+    check_context(context, abieos_set_abi(context, 0, cycle));
+    if (abieos_json_to_bin(context, 0, "uint8", "1") ||
+        abieos_get_error(context) != std::string{"abi recursion limit reached"})
+        throw std::runtime_error("abi with a base cycle was compiled");
+    const char* not_struct = R"({"structs":[{"name":"a","base":"uint8","fields":[]}]})";
+    check_context(context, abieos_set_abi(context, 0, not_struct));
+    if (abieos_json_to_bin(context, 0, "uint8", "1") ||
+        abieos_get_error(context) != std::string{"abi type \"uint8\" is not a struct"})
+        throw std::runtime_error("abi with a non-struct base was compiled");
+    abieos_destroy(context);
+}
+
+void check_conversion_plans() {
+    auto context = check(abieos_create());
+    // recursion through arrays and optionals, builtin structs and arrays, and an optional struct
+    const char* abi = R"({"structs":[
+        {"name":"node","base":"","fields":[{"name":"value","type":"uint8"},{"name":"children","type":"node[]"},
+                                           {"name":"next","type":"node?"}]},
+        {"name":"holder","base":"","fields":[{"name":"asset","type":"extended_asset"},{"name":"names","type":"name[]"},
+                                             {"name":"empty","type":"node[]"},{"name":"none","type":"holder?"},
+                                             {"name":"list","type":"list"}]}],
+        "types":[{"new_type_name":"list","type":"node[]"}]})";
+    check_context(context, abieos_set_abi(context, 0, abi));
+    const char* tree = R"({"value":1,"children":[{"value":2,"children":[],"next":null},{"value":3,"children":[)"
+                       R"({"value":4,"children":[],"next":null}],"next":{"value":5,"children":[],"next":null}}],)"
+                       R"("next":null})";
+    const char* holder = R"({"asset":{"quantity":"1.0000 SYS","contract":"eosio.token"},"names":["a","b"],"empty":[],)"
+                         R"("none":null,"list":[{"value":6,"children":[],"next":null}]})";
+    for (auto [type, json] : {std::pair{"node", tree}, {"holder", holder}}) {
+        check_context(context, abieos_json_to_bin(context, 0, type, json));
+        std::string bin(abieos_get_bin_data(context), abieos_get_bin_size(context));
+        if (abieos_bin_to_json(context, 0, type, bin.data(), bin.size()) != std::string{json})
+            throw std::runtime_error(std::string{"conversion plan mismatch: "} + type);
+    }
+
+    // each step of the plan reports where it stopped
+    for (auto [type, json, error] : {
+             std::tuple{"node", R"({"value":1,"next":null})", R"(node.children: expected field "children")"},
+             {"node", R"({"value":1,"children":[],"next":null,"extra":0})", R"(node: unexpected field "extra")"},
+             {"node", R"({"value":1,"children":[{"value":2,"children":{}}],"next":null})",
+              "node.children[0].children: expected array"},
+             {"holder", R"({"asset":{"quantity":"1.0000 SYS"}})",
+              R"(holder.asset.quantity: expected field "contract")"},
+             {"holder", R"({"asset":{"quantity":"1.0000 SYS","contract":"eosio"},"names":["a",true]})",
+              "holder.names[1]: expected string containing name"},
+         }) {
+        if (abieos_json_to_bin(context, 0, type, json) || abieos_get_error(context) != std::string{error})
+            throw std::runtime_error(std::string{"conversion plan error mismatch: "} + abieos_get_error(context));
+    }
+
+    std::string deep(200, '\1'); // each node's first child, until the plan's stack overflows
+    for (size_t i = 0; i < deep.size(); i += 2)
+        deep[i] = 0;
+    deep += std::string(3, '\0');
+    if (abieos_bin_to_json(context, 0, "node", deep.data(), deep.size()) ||
+        abieos_get_error(context) != std::string{"recursion limit reached"})
+        throw std::runtime_error("deeply nested value was converted");
+    abieos_destroy(context);
+}
+
+void check_type_lookup() {
+    auto context = check(abieos_create());
+    // enough names to collide in the contract's hash table, each struct with an alias
+    std::string abi = R"({"structs":[)", types;
+    for (int i = 0; i < 1000; ++i) {
+        abi += (i ? R"(,{"name":"s)" : R"({"name":"s)") + std::to_string(i) +
+               R"(","base":"","fields":[{"name":"f","type":"uint)" + std::to_string(8 << i % 4) + R"("}]})";
+        types += (i ? R"(,{"new_type_name":"a)" : R"({"new_type_name":"a)") + std::to_string(i) + R"(","type":"s)" +
+                 std::to_string(i) + R"("})";
+    }
+    abi += R"(],"types":[)" + types + "]}";
+    check_context(context, abieos_set_abi(context, 0, abi.c_str()));
+    for (int i = 0; i < 1000; ++i) {
+        auto size = size_t(1) << i % 4;
+        for (auto type : {"s" + std::to_string(i), "a" + std::to_string(i), "s" + std::to_string(i) + "?"}) {
+            auto json = type.back() == '?' ? "null" : R"({"f":1})";
+            check_context(context, abieos_json_to_bin(context, 0, type.c_str(), json));
+            if (size_t(abieos_get_bin_size(context)) != (type.back() == '?' ? 1 : size))
+                throw std::runtime_error("type lookup mismatch: " + type);
+        }
+    }
+    for (auto [type, error] : {std::pair{"s1000", R"(unknown type "s1000")"}, {"a", R"(unknown type "a")"},
+                               {"s1[]?", "optional and array don't support nesting"}}) {
+        if (abieos_json_to_bin(context, 0, type, "null") || abieos_get_error(context) != std::string{error})
+            throw std::runtime_error(std::string{"type lookup: expected "} + error);
+    }
+    abieos_destroy(context);
+}
+
+void check_registry() {
+    auto registry = check(abieos_registry_create());
+    auto a = check(abieos_create_with_registry(registry));
+    auto b = check(abieos_create_with_registry(registry));
+    abieos_registry_release(registry); // the contexts keep it alive
+
+    auto token = abieos_string_to_name(a, "eosio.token");
+    check_context(a, abieos_set_abi_hex(a, token, tokenHexApi));
+    auto handle = check_context(b, abieos_get_type_handle(b, token, "transfer"));
+    check_context(b, abieos_json_to_bin_with_handle(b, handle, transferJson));
+    check_context(b, abieos_json_to_bin(b, token, "name[]", R"(["a","b"])"));
+
+    // replacing the abi through one context makes the other's handles stale
+    check_context(a, abieos_set_abi(a, token, transferAbi));
+    if (abieos_json_to_bin_with_handle(b, handle, transferJson))
+        throw std::runtime_error("handle should be stale after abi was replaced through another context");
+    if (abieos_get_type_handle(b, token, "transfer") != handle)
+        throw std::runtime_error("expected the same handle");
+    check_context(b, abieos_json_to_bin_with_handle(b, handle, transferJson));
+
+    abieos_destroy(a);
+    check_context(b, abieos_bin_to_json(b, token, "transfer", abieos_get_bin_data(b), abieos_get_bin_size(b)));
+    abieos_destroy(b);
+}
+
 void check_types() {
     auto context = check(abieos_create());
     auto token = check_context(context, abieos_string_to_name(context, "eosio.token"));
@@ -241,6 +967,14 @@ void check_types() {
     check_type(context, 0, "float64", R"(0.0)");
     check_type(context, 0, "float64", R"(0.125)");
     check_type(context, 0, "float64", R"(-0.125)");
+    check_context(context, abieos_json_to_bin(context, 0, "float32", R"("nan")"));
+    float nan32 = 0;
+    memcpy(&nan32, abieos_get_bin_data(context), sizeof(nan32));
+    check_context(context, abieos_json_to_bin(context, 0, "float64", R"("nan")"));
+    double nan64 = 0;
+    memcpy(&nan64, abieos_get_bin_data(context), sizeof(nan64));
+    if (!std::isnan(nan32) || !std::isnan(nan64))
+        throw std::runtime_error("NaN wasn't converted");
     check_type(context, 0, "float128", R"("00000000000000000000000000000000")");
     check_type(context, 0, "float128", R"("FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF")");
     check_type(context, 0, "float128", R"("12345678ABCDEF12345678ABCDEF1234")");
@@ -328,19 +1062,62 @@ void check_types() {
     check_type(context, 0, "asset?", R"("0.123456 SIX")");
     check_type(context, 0, "extended_asset", R"({"quantity":"0 FOO","contract":"bar"})");
     check_type(context, 0, "extended_asset", R"({"quantity":"0.123456 SIX","contract":"seven"})");
+    check_type(context, 0, "asset", R"("9223372036854775807 MAX")");
+    check_type(context, 0, "asset", R"("-922337203685477.5807 NEG")");
+
+    // malformed values are reported through the error, with their path
+    for (auto [type, json, error] : {
+             std::tuple{"asset", R"("1.0000")", "invalid asset"},
+             {"asset", R"("1.0000 sys")", "invalid asset"},
+             {"asset", R"("1. SYS")", "invalid asset"},
+             {"asset", R"("1.0000 SYS extra")", "invalid asset"},
+             {"asset", R"("9223372036854775808 SYS")", "invalid asset"},
+             {"extended_asset", R"({"quantity":"SYS","contract":"a"})", "extended_asset.quantity: invalid asset"},
+             {"symbol", R"("4SYS")", "invalid symbol"},
+             {"symbol", R"("19,SYS")", "invalid symbol"},
+             {"symbol_code", R"("TOOLONGX")", "invalid symbol_code"},
+             {"uint8", R"("256")", "number is out of range"},
+             {"time_point_sec", R"("2018-13-01T00:00:00")", "Month number is out of range 1..12"},
+             {"block_timestamp_type", R"("soon")",
+              "bad lexical cast: source type value could not be interpreted as target"},
+         }) {
+        if (abieos_json_to_bin(context, 0, type, json) || abieos_get_error(context) != std::string{error})
+            throw std::runtime_error(std::string{"malformed "} + type + ": " + abieos_get_error(context));
+    }
 
-    check_type(context, token, "transfer",
-               R"({"from":"useraaaaaaaa","to":"useraaaaaaab","quantity":"0.0001 SYS","memo":"test memo"})");
+    check_type(context, token, "transfer", transferJson);
     check_type(
         context, 0, "transaction",
         R"({"expiration":"2009-02-13T23:31:31.000","ref_block_num":1234,"ref_block_prefix":5678,"max_net_usage_words":0,"max_cpu_usage_ms":0,"delay_sec":0,"context_free_actions":[],"actions":[{"account":"eosio.token","name":"transfer","authorization":[{"actor":"useraaaaaaaa","permission":"active"}],"data":"608C31C6187315D6708C31C6187315D60100000000000000045359530000000000"}],"transaction_extensions":[]})");
 
+    check_bin_to_json_batch(context, token);
+    check_json_to_bin_batch(context, token);
+    check_type_handles(context, token);
+    check_into(context, token);
+    check_results(context, token);
+
+    auto kept = check_context(context, abieos_json_to_bin_result(context, 0, "string", R"("outlives context")"));
     abieos_destroy(context);
+    if (abieos_result_size(kept) != 17)
+        throw std::runtime_error("result didn't outlive context");
+    abieos_result_release(kept);
 }
 
 int main() {
     try {
         check_types();
+        check_allocator();
+        check_concurrent();
+        check_registry();
+        check_abi_errors();
+        check_inheritance();
+        check_type_lookup();
+        check_conversion_plans();
+        check_eviction();
+        check_history();
+        check_saved_registry();
+        check_shared_registry();
+        check_bulk_abis();
         return 0;
     } catch (std::exception& e) {
         printf("error: %s\n", e.what());